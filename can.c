@@ -1,131 +1,270 @@
 /* can.c - Implementacin de las funciones de can.h. */
 #include "can.h"
+#include "irq.h"
+#include "prof.h"
 
-void CANSendBMsg(unsigned int id, unsigned int dlc, unsigned char *msg) {
-	
-	// Standard Id
-	C1TX0SIDbits.SID5_0 = id;
-	id = id >> 6;
-	C1TX0SIDbits.SID10_6 = id;
-
-	// RTR
-	C1TX0DLCbits.TXRTR = 0;		// Normal message
-
-	// IDE
-	C1TX0SIDbits.TXIDE = 0;		// Standard identifier
-
-	// DLC
-	C1TX0DLCbits.DLC = dlc;		// Data Length Code
-
-	// Message
-	unsigned int aux;
-	switch (dlc) {
-		case 1:
-			C1TX0B1 = msg[0];
-			break;
-		case 2:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			break;
-		case 3:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			C1TX0B2 = msg[2];
-			break;
-		case 4:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			aux = msg[3];
-			aux = aux << 8;
-			C1TX0B2 = aux | msg[2];
-			break;
-		case 5:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			aux = msg[3];
-			aux = aux << 8;
-			C1TX0B2 = aux | msg[2];
-			C1TX0B3 = msg[4];
-			break;
-		case 6:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			aux = msg[3];
-			aux = aux << 8;
-			C1TX0B2 = aux | msg[2];
-			aux = msg[5];
-			aux = aux << 8;
-			C1TX0B3 = aux | msg[4];
-			break;
-		case 7:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			aux = msg[3];
-			aux = aux << 8;
-			C1TX0B2 = aux | msg[2];
-			aux = msg[5];
-			aux = aux << 8;
-			C1TX0B3 = aux | msg[4];
-			C1TX0B4 = msg[6];
-			break;
-		case 8:
-			aux = msg[1];
-			aux = aux << 8;
-			C1TX0B1 = aux | msg[0];
-			aux = msg[3];
-			aux = aux << 8;
-			C1TX0B2 = aux | msg[2];
-			aux = msg[5];
-			aux = aux << 8;
-			C1TX0B3 = aux | msg[4];
-			aux = msg[7];
-			aux = aux << 8;
-			C1TX0B4 = aux | msg[6];
+#define TX_MASK		(CAN_TX_QUEUE - 1)
+#define RX_MASK		(CAN_RX_QUEUE - 1)
+
+// Frames waiting for a free hardware buffer
+static volatile CANFrame tx_queue[CAN_TX_QUEUE];
+static volatile unsigned char tx_head, tx_tail;
+// Statistics
+static volatile unsigned int tx_high_water, tx_dropped;
+
+// Frames received and not yet taken. Single producer (_C1Interrupt) and
+// single consumer (main loop): each side only writes its own index.
+static volatile CANFrame rx_queue[CAN_RX_QUEUE];
+static volatile unsigned char rx_head, rx_tail;
+// Statistics
+static volatile unsigned int rx_high_water, rx_dropped, rx_overflows;
+
+// Copy a frame into tx buffer N and request its transmission
+#define TX_LOAD(N, f, pri) \
+	C1TX##N##CONbits.TXPRI = (pri); \
+	C1TX##N##SIDbits.SID5_0 = (f)->id; \
+	C1TX##N##SIDbits.SID10_6 = (f)->id >> 6; \
+	C1TX##N##SIDbits.TXIDE = 0;			/* Standard identifier */ \
+	C1TX##N##DLCbits.TXRTR = 0;			/* Normal message */ \
+	C1TX##N##DLCbits.DLC = (f)->dlc; \
+	C1TX##N##B1 = (f)->data[0]; \
+	C1TX##N##B2 = (f)->data[1]; \
+	C1TX##N##B3 = (f)->data[2]; \
+	C1TX##N##B4 = (f)->data[3]; \
+	C1TX##N##CONbits.TXREQ = 1			/* Send message */
+
+// Copy rx buffer N into the reception queue and release it
+#define RX_STORE(N) \
+	next = (rx_head + 1) & RX_MASK; \
+	if (next == rx_tail) { \
+		rx_dropped++;					/* Queue full, the newest frame is lost */ \
+	} else { \
+		f = &rx_queue[rx_head]; \
+		f->id = C1RX##N##SIDbits.SID; \
+		f->dlc = C1RX##N##DLCbits.DLC; \
+		f->data[0] = C1RX##N##B1; \
+		f->data[1] = C1RX##N##B2; \
+		f->data[2] = C1RX##N##B3; \
+		f->data[3] = C1RX##N##B4; \
+		rx_head = next; \
+		depth = (rx_head - rx_tail) & RX_MASK; \
+		if (depth > rx_high_water) rx_high_water = depth; \
+	} \
+	C1RX##N##CONbits.RXFUL = 0			/* Clear reception full status flag */
+
+/* Moves queued frames into the free hardware buffers.
+ * The hardware sends the highest priority first, so a frame is loaded with a
+ * priority below every frame still pending to keep the queue order. Pending
+ * priorities are never raised: writing TXPRI of a pending buffer could race
+ * with the end of its transmission. Once a pending frame has priority 0 the
+ * queue waits for it, which is the last frame the hardware has left: with a
+ * steady stream, the bus waits for this interrupt once every four frames.
+ * Must run with the CAN interrupt masked or from _C1Interrupt.
+ */
+static void tx_feed() {
+	unsigned char free0, free1, free2, tx_pri = 4;
+
+	free0 = !C1TX0CONbits.TXREQ;
+	free1 = !C1TX1CONbits.TXREQ;
+	free2 = !C1TX2CONbits.TXREQ;
+	// Below the lowest priority still pending
+	if (!free0 && C1TX0CONbits.TXPRI < tx_pri) tx_pri = C1TX0CONbits.TXPRI;
+	if (!free1 && C1TX1CONbits.TXPRI < tx_pri) tx_pri = C1TX1CONbits.TXPRI;
+	if (!free2 && C1TX2CONbits.TXPRI < tx_pri) tx_pri = C1TX2CONbits.TXPRI;
+
+	while (tx_head != tx_tail && tx_pri > 0) {
+		volatile CANFrame *f = &tx_queue[tx_tail];
+		if (free0) {
+			TX_LOAD(0, f, tx_pri - 1);
+			free0 = 0;
+		} else if (free1) {
+			TX_LOAD(1, f, tx_pri - 1);
+			free1 = 0;
+		} else if (free2) {
+			TX_LOAD(2, f, tx_pri - 1);
+			free2 = 0;
+		} else {
 			break;
+		}
+		tx_pri--;
+		tx_tail = (tx_tail + 1) & TX_MASK;
+	}
+}
+
+void CANSendFrame(const CANFrame *frame) {
+	unsigned int ipl;
+	unsigned char next;
+	unsigned int depth;
+	PROF_ENTER(PROF_CAN_SEND);
+
+	IRQ_DISABLE(ipl);
+	next = (tx_head + 1) & TX_MASK;
+	if (next == tx_tail) {
+		tx_dropped++;			// Queue full, the newest frame is lost
+	} else {
+		tx_queue[tx_head] = *frame;
+		tx_head = next;
+		depth = (tx_head - tx_tail) & TX_MASK;
+		if (depth > tx_high_water) tx_high_water = depth;
+	}
+	tx_feed();
+	IRQ_RESTORE(ipl);
+	PROF_EXIT(PROF_CAN_SEND);
+}
+
+void CANSendBMsg(unsigned int id, unsigned int dlc, unsigned char *msg) {
+	CANFrame f;
+	unsigned int i;
+	PROF_ENTER(PROF_CAN_SEND_B);
+
+	f.id = id;
+	f.dlc = dlc;
+	f.data[0] = f.data[1] = f.data[2] = f.data[3] = 0;
+	for (i = 0; i < dlc && i < MAX_MSG; i++) {
+		if (i & 1) f.data[i >> 1] |= (unsigned int)msg[i] << 8;
+		else f.data[i >> 1] = msg[i];
+	}
+	CANSendFrame(&f);
+	PROF_EXIT(PROF_CAN_SEND_B);
+}
+
+void CANSendMsg(unsigned int id, unsigned int dlc, unsigned int *msg) {
+	CANFrame f;
+	unsigned int i;
+
+	f.id = id;
+	f.dlc = dlc*2;
+	f.data[0] = f.data[1] = f.data[2] = f.data[3] = 0;
+	for (i = 0; i < dlc && i < MAX_MSG/2; i++) {
+		f.data[i] = msg[i];
+	}
+	CANSendFrame(&f);
+}
+
+void CANTxInterrupt() {
+	if (C1INTFbits.TX0IF == 1) C1INTFbits.TX0IF = 0;
+	if (C1INTFbits.TX1IF == 1) C1INTFbits.TX1IF = 0;
+	if (C1INTFbits.TX2IF == 1) C1INTFbits.TX2IF = 0;
+	tx_feed();
+}
+
+unsigned int CANTxDepth() {
+	return (tx_head - tx_tail) & TX_MASK;
+}
+
+unsigned int CANTxHighWater() {
+	return tx_high_water;
+}
+
+unsigned int CANTxDropped() {
+	return tx_dropped;
+}
+
+void CANRxInterrupt() {
+	volatile CANFrame *f;
+	unsigned char next;
+	unsigned int depth;
+
+	// Flags are cleared before reading so a frame arriving meanwhile raises a new
+	// interrupt. No order between the buffers: a frame goes to rx buffer 1 while
+	// buffer 0 is full, and the next one to buffer 0 once it is released.
+	do {
+		C1INTFbits.RX0IF = 0;
+		C1INTFbits.RX1IF = 0;
+		if (C1RX0CONbits.RXFUL == 1) {
+			RX_STORE(0);
+		}
+		if (C1RX1CONbits.RXFUL == 1) {
+			RX_STORE(1);
+		}
+	} while (C1RX0CONbits.RXFUL == 1 || C1RX1CONbits.RXFUL == 1);
+
+	// A frame arrived with both buffers full
+	if (C1INTFbits.RX0OVR == 1) {
+		rx_overflows++;
+		C1INTFbits.RX0OVR = 0;
 	}
+	if (C1INTFbits.RX1OVR == 1) {
+		rx_overflows++;
+		C1INTFbits.RX1OVR = 0;
+	}
+}
+
+unsigned char CANRecv(CANFrame *frame) {
+	if (rx_tail == rx_head) return 0;
+	*frame = rx_queue[rx_tail];
+	rx_tail = (rx_tail + 1) & RX_MASK;
+	return 1;
+}
+
+unsigned int CANRxDepth() {
+	return (rx_head - rx_tail) & RX_MASK;
+}
 
-	C1TX0CONbits.TXREQ = 1;		// Send message
-}
-
-void CANSendMsg(unsigned int id, unsigned int dlc, unsigned int *msg) {
-	// Standard Id
-	C1TX0SIDbits.SID5_0 = id;
-	id = id >> 6;
-	C1TX0SIDbits.SID10_6 = id;
-
-	// RTR
-	C1TX0DLCbits.TXRTR = 0;		// Normal message
-
-	// IDE
-	C1TX0SIDbits.TXIDE = 0;		// Standard identifier
-
-	// DLC
-	C1TX0DLCbits.DLC = dlc*2;	// Data Length Code
-	
-	int aux;
-	if (dlc >= 1) {
-		aux = msg[0];
-		C1TX0B1 = aux;
-	}
-	if (dlc >= 2) {
-		aux = msg[1];
-		C1TX0B2 = aux;
-	}
-	if (dlc >= 3) {
-		aux = msg[2];
-		C1TX0B3 = aux;
-	}
-	if (dlc >= 4) {
-		aux = msg[3];
-		C1TX0B4 = aux;
-	}
-	
-	C1TX0CONbits.TXREQ = 1;				// Send message
-	while (C1TX0CONbits.TXREQ == 1);	// Wait until successfully transmitted
-}
+unsigned int CANRxHighWater() {
+	return rx_high_water;
+}
+
+unsigned int CANRxDropped() {
+	return rx_dropped;
+}
+
+unsigned int CANRxOverflows() {
+	return rx_overflows;
+}
+
+/* Computes the filters of one rx buffer for a group of identifiers
+ * return: the acceptance mask shared by the k filters
+ */
+static unsigned int filter_group(const unsigned int *ids, unsigned int n,
+								 unsigned int *filters, unsigned int k) {
+	unsigned int i, mask;
+
+	if (n <= k) {
+		// One exact filter per identifier, unused ones repeat the last
+		for (i = 0; i < k; i++) filters[i] = ids[(i < n) ? i : n - 1];
+		return 0x7FF;
+	}
+	// Too many identifiers: only compare the bits common to all of them
+	mask = 0x7FF;
+	for (i = 1; i < n; i++) mask &= ~(ids[i] ^ ids[0]);
+	for (i = 0; i < k; i++) filters[i] = ids[0] & mask;
+	return mask;
+}
+
+void CANSetFilters(const unsigned int *ids0, unsigned int n0,
+				   const unsigned int *ids1, unsigned int n1) {
+	unsigned int filters[6];
+	unsigned int mask0, mask1;
+
+	if (n0 == 0 && n1 == 0) return;
+	if (n0 == 0) {
+		ids0 = ids1;
+		n0 = n1;
+	} else if (n1 == 0) {
+		ids1 = ids0;
+		n1 = n0;
+	}
+	mask0 = filter_group(ids0, n0, &filters[0], 2);
+	mask1 = filter_group(ids1, n1, &filters[2], 4);
+
+	// Acceptance masks
+	C1RXM0SIDbits.SID = mask0;
+	C1RXM0SIDbits.MIDE = 1; 	// Identifier mode as determined by EXIDE
+	C1RXM1SIDbits.SID = mask1;
+	C1RXM1SIDbits.MIDE = 1;
+
+	// Acceptance filters 0-1 (rx buffer 0) and 2-5 (rx buffer 1)
+	C1RXF0SIDbits.EXIDE = 0; 	// Standard identifier
+	C1RXF0SIDbits.SID = filters[0];
+	C1RXF1SIDbits.EXIDE = 0;
+	C1RXF1SIDbits.SID = filters[1];
+	C1RXF2SIDbits.EXIDE = 0;
+	C1RXF2SIDbits.SID = filters[2];
+	C1RXF3SIDbits.EXIDE = 0;
+	C1RXF3SIDbits.SID = filters[3];
+	C1RXF4SIDbits.EXIDE = 0;
+	C1RXF4SIDbits.SID = filters[4];
+	C1RXF5SIDbits.EXIDE = 0;
+	C1RXF5SIDbits.SID = filters[5];
+}
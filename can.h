@@ -1,9 +1,63 @@
 /* can.h - Librera con las utilidades del CAN. */
+#ifndef CAN_H
+#define CAN_H
 #include <p30f4011.h>
 #define MAX_MSG	8
 
-// Transmite message
+// Transmission queue length in frames (power of 2, one slot is kept free)
+#ifndef CAN_TX_QUEUE
+#define CAN_TX_QUEUE	16
+#endif
+// Reception queue length in frames (power of 2, one slot is kept free)
+#ifndef CAN_RX_QUEUE
+#define CAN_RX_QUEUE	16
+#endif
+
+// Frame as kept in the software queues
+typedef struct {
+	unsigned int id;		// Standard identifier
+	unsigned int dlc;		// Data Length Code (bytes)
+	unsigned int data[4];	// Payload, same word layout as CxTXnB1..CxTXnB4
+} CANFrame;
+
+// Queue message for transmission, returns without waiting for the bus
 // DLC = msg's number of bytes
-void CANSendBMsg(unsigned int id, unsigned int dlc, unsigned char *msg);
-// DLC = msg's number of integer
+void CANSendBMsg(unsigned int id, unsigned int dlc, unsigned char *msg);
+// DLC = msg's number of integer
 void CANSendMsg(unsigned int id, unsigned int dlc, unsigned int *msg);
+// Queue an already built frame
+void CANSendFrame(const CANFrame *frame);
+
+// Transmission complete handler, must be called from _C1Interrupt
+// (requires TX0IE, TX1IE and TX2IE enabled)
+void CANTxInterrupt(void);
+
+// Transmission queue statistics
+unsigned int CANTxDepth(void);		// Frames waiting for a hardware buffer
+unsigned int CANTxHighWater(void);	// Maximum depth reached
+unsigned int CANTxDropped(void);	// Frames discarded because the queue was full
+
+// Reception handler, must be called from _C1Interrupt
+// (requires RX0IE and RX1IE enabled, rx buffer 0 double buffered into rx buffer 1).
+// Frames of one buffer keep their order, frames of both may not: receivers that
+// need the order of a message use its sequence number (proto.h).
+void CANRxInterrupt(void);
+// Take the oldest received frame, returns 0 if there is none
+unsigned char CANRecv(CANFrame *frame);
+
+// Reception queue statistics
+unsigned int CANRxDepth(void);		// Frames waiting to be taken
+unsigned int CANRxHighWater(void);	// Maximum depth reached
+unsigned int CANRxDropped(void);	// Frames discarded because the queue was full
+unsigned int CANRxOverflows(void);	// Frames lost by the hardware (RX0OVR/RX1OVR)
+
+// Program both acceptance masks and the six filters so only the listed standard
+// identifiers are received. Must be called in configuration mode. The ids0
+// identifiers go to rx buffer 0 (2 filters, double buffered, two frames deep),
+// the ids1 identifiers to rx buffer 1 (4 filters, one frame deep): messages sent
+// in bursts belong in ids0. Groups larger than their filters share a mask on the
+// common bits and may accept a few extra ids. An empty group takes the other's.
+void CANSetFilters(const unsigned int *ids0, unsigned int n0,
+				   const unsigned int *ids1, unsigned int n1);
+
+#endif
@@ -0,0 +1,15 @@
+/* cycles.c - Implementación de las funciones de cycles.h. */
+#include "cycles.h"
+
+void CyclesInit() {
+	if (T2CONbits.TON) return;	// Already counting
+	T2CON = 0;					// Timers off, internal clock, prescaler 1:1
+	T3CON = 0;
+	T2CONbits.T32 = 1;			// Timer2 and Timer3 as one 32-bit timer
+	TMR3 = 0;
+	TMR2 = 0;
+	PR3 = 0xFFFF;				// Free running
+	PR2 = 0xFFFF;
+	IEC0bits.T3IE = 0;
+	T2CONbits.TON = 1;
+}
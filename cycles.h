@@ -0,0 +1,19 @@
+/* cycles.h - Reloj libre de 32 bits en ciclos de instrucción con el Timer2 y el Timer3. */
+#ifndef CYCLES_H
+#define CYCLES_H
+#include <p30f4011.h>
+
+// Start Timer2 and Timer3 as one 32-bit timer counting instruction cycles, free
+// running (it wraps every 2^32 cycles, 145 s at 29.49 MHz). Only the first call
+// starts it, so every module that stamps with it can call it.
+void CyclesInit(void);
+
+// Current count. Reading TMR2 latches Timer3 into TMR3HLD, so another reader
+// must not interrupt the two reads: call it with those interrupts masked.
+static inline unsigned long CyclesRead(void) {
+	unsigned int low = TMR2;
+
+	return ((unsigned long)TMR3HLD << 16) | low;
+}
+
+#endif
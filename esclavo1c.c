@@ -9,6 +9,18 @@
 #include <p30f4011.h>
 #include <uart.h>
 #include "can.h"
+#include "proto.h"
+#include "physics.h"
+#include "term.h"
+#include "screen.h"
+#include "glyph.h"
+#include "uarttx.h"
+#include "seqlock.h"
+#include "evq.h"
+#include "lat.h"
+#include "trace.h"
+#include "prof.h"
+#include "stats.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -32,91 +44,161 @@ _FGS(CODE_PROT_OFF);
 /******************************************************************************/
 /* Constants				                                                  */
 /******************************************************************************/
-#define	WIDTH		80
-#define	LENGTH		24
-
-#define	BALL_L		1
-#define	PADDLE_L	5
-#define PADDLE_W	2
-
-#define	PAD1_X		2
-#define	PAD2_X		76
-
+// Player 1's number ends with the digit at SCORE1_X and player 2's starts with
+// the digit at SCORE2_X, both grow away from the centre
 #define SCORE1_X	31
 #define SCORE2_X	44
 #define SCORE_Y		1
+#define SCORE_DIGITS	3				// Scores up to 999
+#define SCORE_MAX		1000
+#define DIGIT_STEP		(GLYPH_COLS+1)	// Digit and a blank column
+#define DIGIT_NONE		10				// Digit position left blank
 
 #define UP			'i'
 #define DOWN		'k'
 #define SERVICE		'j'
+#define REPORT		'l'			// Latency report instead of the game, and back
+#define DUMP		't'			// Trace dumps instead of the game, and back
+#define CYCLES		'p'			// Profile report instead of the game, and back
+#define COUNTERS	's'			// Counters of the nodes instead of the game, and back
 
-#define FILL		"#"
-#define BALL		"O"
-
-#define	M_BALL		00
-#define	M_BOUNCE	02
-#define	M_POINT		04
-#define	S1_PADDLE	10
-#define	S1_SERVICE	11
-#define	S2_PADDLE	20
-#define	S2_SERVICE	21
+// Counters report: this node's on the left, the master's from this column
+#define STATS_TITLE		"counters            node       value"
+#define MASTER_STATS_X	40
+
+// Frame pacing: one frame every FRAME_MS at most, with all the changes since
+// the last one. A frame sends no more bytes than the UART sends in FRAME_MS
+// (10 bits a byte) and leaves room in the tx queue for one cell over budget.
+#define FRAME_MS			40				// 25 frames per second
+#define FRAME_UART_BYTES	((BAUD_RATE/10)*FRAME_MS/1000)
+#define FRAME_QUEUE_BYTES	(UART_TX_QUEUE-16)
+#define FRAME_BYTES			(FRAME_UART_BYTES < FRAME_QUEUE_BYTES ? FRAME_UART_BYTES : FRAME_QUEUE_BYTES)
+
+// Own paddle position sent once every PADDLE_MS at most (one master tick)
+#define PADDLE_MS			10
+
+// Characters of the screen cells: SCREEN_BLANK, SCREEN_FILL, SCREEN_BALL, SCREEN_OTHER
+#define CELL_CHARS	" #O?"
 
 /******************************************************************************/
 /* Global Variable declaration                                                */
 /******************************************************************************/
-// Ball coordenates (Range: 0-WIDTH, 0-LENGTH)
-volatile unsigned int bx, by;
-// Paddle 1 and 2 top left coordinates (Range: PAD1_X, 0-(LENGTH-PADDLE_L), PAD2_X, 0-(LENGTH-PADDLE_L))
-volatile unsigned int p1x, p1y, p2x, p2y;
-// Scoreboard
-volatile unsigned int score[2];
-// Previous versions of ball and paddle variables
-volatile unsigned int pre_bx, pre_by, pre_p1y, pre_p2y;
-// Current screen cursor position (Range: 0-WIDTH, 0-LENGTH)
-unsigned int cx, cy;
+// Game state, written only between SeqWriteBegin and SeqWriteEnd on game_seq:
+// by the UART rx interrupt, and by the main loop with that interrupt disabled,
+// so one at a time
+typedef struct {
+	unsigned int bx, by;			// Ball coordinates of M_BALL (Range: 0-WIDTH, 0-LENGTH)
+	unsigned int p1y, p2y;			// Paddle top rows (Range: 0-(LENGTH-PADDLE_L))
+	unsigned int score[2];			// Scoreboard
+	// Last ball trajectory received: fixed point position and velocity per tick
+	// at master tick traj_tick, received at time traj_time (ms)
+	unsigned char traj_valid;
+	int traj_x, traj_y, traj_vx, traj_vy;
+	unsigned int traj_tick, traj_time;
+} GameState;
+GameState game;
+SeqCount game_seq;
+// Consistent copy of the game state the main loop draws
+GameState view;
+// Ball coordinates to draw, extrapolated from the view (Range: 0-WIDTH, 0-LENGTH)
+unsigned int bx, by;
+// Paddle 1 and 2 columns
+unsigned int p1x, p2x;
+// Ball, paddles and scores as drawn on the terminal
+unsigned int pre_bx, pre_by, pre_p1y, pre_p2y, pre_score[2];
+// Longest CAN and UART rx interrupts, in Timer1 counts (cycles), and UART rx
+// overruns (bytes lost)
+unsigned int c1_isr_max, u1rx_isr_max, u1rx_overruns;
+// Own paddle position last sent, when (ms) and its sequence number, and sequence
+// number of the last position received of the other paddle
+unsigned int sent_p1y, paddle_time, p1_seq, p2_seq;
+// Digits drawn on each scoreboard, left first (DIGIT_NONE if blank)
+unsigned char score_digits[2][SCORE_DIGITS];
+// Bytes sent and bytes saved by the cursor moves in the last frame drawn, and
+// in all of them
+unsigned int frame_bytes, frame_saved;
+unsigned long total_bytes, total_saved;
+// Milliseconds since start-up
+volatile unsigned int ms;
+// Time the last frame was drawn or dropped (ms) and changes seen since then
+unsigned int frame_time, frame_changes;
+// Frames drawn, dropped because the UART was still sending the previous one,
+// and changes merged into a later frame instead of getting their own
+unsigned int frames_drawn, frames_dropped, frames_coalesced;
+
+// Key of the report shown instead of the game, 0 while the game is shown
+unsigned char reporting;
+// Last row written in each column of the counters report
+unsigned int stats_row, master_row;
+
+// Identifiers of the messages handled by this node: the trajectories and the
+// counters the master sends in a burst in rx buffer 0, the rest in rx buffer 1
+const unsigned int rx0_ids[] = {M_TRAJ, STATS_DUMP};
+const unsigned int rx1_ids[] = {S2_PADDLE, M_BALL, M_BOUNCE, M_POINT};
 
 /******************************************************************************/
 /* Interrupts                                                                 */
 /******************************************************************************/
+// Called by the interrupts, see Procedures
+void isr_time(unsigned int *max, unsigned int start, unsigned char pending);
+
 void _ISR _U1RXInterrupt() {
-	unsigned char c = ReadUART1();
+	unsigned int start = TMR1;
+	unsigned char pending = IFS0bits.T1IF;
+	unsigned char c;
+	PROF_ENTER(PROF_U1RX_ISR);
 	
-	if (c == UP) if (p1y > 0) {pre_p1y = p1y; p1y -= 1; CANSendMsg(S1_PADDLE, 1, &p1y);}
-	if (c == DOWN) if (p1y < LENGTH-PADDLE_L) {pre_p1y = p1y; p1y += 1; CANSendMsg(S1_PADDLE, 1, &p1y);}
-	if (c == SERVICE) CANSendMsg(S1_SERVICE, 0, 0);
+	// Every byte received: the keys only move the paddle, the main loop sends it
+	SeqWriteBegin(&game_seq);
+	while (DataRdyUART1()) {
+		c = ReadUART1();
+		TRACE_LOG(TR_ISR_U1RX, c);
+		if (c == UP) if (game.p1y > 0) game.p1y -= 1;
+		if (c == DOWN) if (game.p1y < LENGTH-PADDLE_L) game.p1y += 1;
+		if (c == SERVICE) EvqPost(EV_SERVE, 1);
+		if (c == UP || c == DOWN) LAT_START(LAT_KEY);
+		if (c == REPORT || c == DUMP || c == CYCLES || c == COUNTERS) EvqPost(EV_REPORT, c);
+	}
+	SeqWriteEnd(&game_seq);
+	
+	// Reception stops after an overrun until it is cleared
+	if (U1STAbits.OERR) {
+		U1STAbits.OERR = 0;
+		u1rx_overruns++;
+	}
 	
 	IFS0bits.U1RXIF = 0;
+	PROF_EXIT(PROF_U1RX_ISR);
+	isr_time(&u1rx_isr_max, start, pending);
+}
+
+void _ISR _U1TXInterrupt() {
+	IFS0bits.U1TXIF = 0;
+	UartTxInterrupt();				// Refill the UART with the queued bytes
+}
+
+void _ISR _T1Interrupt() {
+	ms++;
+	IFS0bits.T1IF = 0;
 }
 
 void _ISR _C1Interrupt() {
-	if (C1INTFbits.RX0IF == 1) {
-		int winner;
-		unsigned int id = C1RX0SIDbits.SID;
-		switch (id) {
-			case M_BALL:
-				pre_bx = bx;
-				bx = C1RX0B1;
-				pre_by = by;
-				by = C1RX0B2;
-				break;
-			case M_BOUNCE:
-				WriteUART1(7);			// Send the buzzer character back to the UART
-				while (BusyUART1());	// Wait until the character is transmitted
-				break;
-			case M_POINT:
-				winner = C1RX0B1;
-				score[winner-1] = (score[winner-1] + 1) % 10;
-				break;
-			case S2_PADDLE:
-				pre_p2y = p2y;
-				p2y = C1RX0B1;
-				break;
-		}
-
-		C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
-		C1INTFbits.RX0IF = 0;
-	}
+	unsigned int start = TMR1;
+	unsigned char pending = IFS0bits.T1IF;
+	PROF_ENTER(PROF_C1_ISR);
+	
+	TRACE_LOG(TR_ISR_C1, C1INTF);
+#ifdef LATENCY
+	if (C1INTFbits.RX0IF || C1INTFbits.RX1IF) LatStart(LAT_RXISR);
+#endif
+	CANRxInterrupt();				// Move the received frames to the rx queue
+#ifdef LATENCY
+	if (C1INTFbits.TX0IF || C1INTFbits.TX1IF || C1INTFbits.TX2IF) LatMark(LAT_SENT, LAT_QUEUED);
+#endif
+	CANTxInterrupt();				// Refill the tx buffers already sent
 	IFS1bits.C1IF = 0;
+	PROF_EXIT(PROF_C1_ISR);
+	isr_time(&c1_isr_max, start, pending);
 }
 
 /******************************************************************************/
@@ -124,27 +206,88 @@ void _ISR _C1Interrupt() {
 /******************************************************************************/
 void UARTConfig();
 void CAN_config();
+void T1_config();
 void slave1_init();
 void clear_screen();
+void process_messages();
+void read_state(GameState *copy);
+void process_events();
+void send_paddle();
+void ball_received(const CANFrame *frame);
+void traj_received(const CANFrame *frame);
+void extrapolate_ball();
+void bounce_received(const CANFrame *frame);
+void point_received(const CANFrame *frame);
+void paddle2_received(const CANFrame *frame);
+void stats_received(const CANFrame *frame);
 void draw_screen();
-void draw_number(unsigned int number);
+unsigned char state_changed();
+void update_screen(unsigned int budget);
+void draw_paddle_rows(unsigned int x, unsigned int first, unsigned int last, unsigned char fill);
+void move_paddle(unsigned int x, unsigned int old_y, unsigned int new_y);
+void redraw_score(unsigned int player);
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill);
+void toggle_report(unsigned char key);
+void print_latency();
+void print_profile();
+void print_stats();
+void print_counter(unsigned char node, unsigned char counter, unsigned long value);
+void put_number(unsigned long number, unsigned int width);
 
 /******************************************************************************/
 /* Procedures                                                                 */
 /******************************************************************************/
 int main(void){
+	// Game state ready before the interrupts publish to it
+	slave1_init();
+	
 	UARTConfig();
 	CAN_config();
-	
-	slave1_init();
+	T1_config();
+	LAT_INIT();
+	TRACE_INIT(1);
+	PROF_INIT(1);
 	
 	int j;
 	for (j = 0; j < 1600; j++) Delay5ms();
+	ScreenInit(CELL_CHARS);
 	clear_screen();
+	process_messages();
+	read_state(&view);
+	extrapolate_ball();
 	draw_screen();
-	while (1) {		
-		if (pre_bx != bx || pre_by != by || pre_p1y != p1y || pre_p2y != p2y) 
-			draw_screen();
+	while (1) {
+		process_messages();
+		read_state(&view);
+		extrapolate_ball();
+		if (state_changed()) frame_changes++;
+		
+		process_events();
+		send_paddle();
+		if (reporting) continue;
+#ifdef LATENCY
+		// The last frame drawn is out of the UART
+		if (UartTxDepth() == 0 && U1STAbits.TRMT) LatMark(LAT_OUT, LAT_RENDER);
+#endif
+		
+		// Nothing to draw, or too soon for another frame
+		if (!frame_changes && !ScreenDirty()) continue;
+		if ((unsigned int)(ms - frame_time) < FRAME_MS) continue;
+		frame_time = ms;
+		
+		if (UartTxDepth() > 0) {
+			// The last frame is still being sent, draw everything in the next one
+			frames_dropped++;
+			TRACE_LOG(TR_FRAME_DROP, UartTxDepth());
+			continue;
+		}
+		if (frame_changes > 1) frames_coalesced += frame_changes - 1;
+		TRACE_LOG(TR_FRAME, frame_changes);
+		frame_changes = 0;
+		LAT_MARK(LAT_RENDER, LAT_RX);
+		update_screen(FRAME_BYTES);
+		TRACE_LOG(TR_FRAME_END, frame_bytes);
+		frames_drawn++;
 	}
 	
 	return 0;
@@ -164,10 +307,24 @@ void UARTConfig(){
 
 			  BRG);                 // Baudrate
 	U1STAbits.URXISEL = 0;
+	U1STAbits.UTXISEL = 1;			// Tx interrupt when the transmit buffer is empty
 			  
 	// Enable UART Rx Interrupts
 	IEC0bits.U1RXIE = 1;
 	IFS0bits.U1RXIF = 0;
+	// UART Tx Interrupts are enabled while there are bytes queued
+	IEC0bits.U1TXIE = 0;
+	IFS0bits.U1TXIF = 0;
+}
+
+void T1_config() {
+	T1CON = 0;					// Timer off, internal clock, prescaler 1:1
+	TMR1 = 0;
+	PR1 = FCY/1000 - 1;			// Period of 1 ms
+	
+	IEC0bits.T1IE = 1;			// Enable Timer1 interrupt
+	IFS0bits.T1IF = 0;			// Clear Timer1 interrupt flag
+	T1CONbits.TON = 1;			// Start Timer1
 }
 
 void CAN_config() {
@@ -197,26 +354,36 @@ void CAN_config() {
 	// Local CAN interrupts
 	C1INTEbits.RX0IE = 1; 		// Enable CAN interrupt associated to rx buffer 0
 	C1INTFbits.RX0IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 0
-	
-	/* Tx buffer 0 */
+	C1INTEbits.RX1IE = 1; 		// Enable CAN interrupt associated to rx buffer 1
+	C1INTFbits.RX1IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 1
+	C1INTEbits.TX0IE = 1; 		// Enable CAN interrupts associated to tx buffers 0-2
+	C1INTEbits.TX1IE = 1;
+	C1INTEbits.TX2IE = 1;
+	C1INTFbits.TX0IF = 0; 		// Clear CAN interrupt flags associated to tx buffers 0-2
+	C1INTFbits.TX1IF = 0;
+	C1INTFbits.TX2IF = 0;
+
+	/* Tx buffers 0-2 */
 
 	// General transmission configuration
-	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flag
+	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flags
+	C1TX1CONbits.TXREQ = 0;
+	C1TX2CONbits.TXREQ = 0;
 
 	/* Rx buffer 0 */
 	
 	// General reception configuration
 	C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
-	C1RX0CONbits.DBEN = 0; 		// Disable double buffer
-
-	// Configure acceptance mask
-	C1RXM0SIDbits.SID = 0b0000000001;	// Mask to check if sid is odd or even
-	C1RXM0SIDbits.MIDE = 1; 			// Identifier mode as determined by EXIDE
-	C1RX0CONbits.FILHIT0 = 0; 			// Link to acceptance filter 0
+	C1RX0CONbits.DBEN = 1; 		// Overflow into rx buffer 1 when rx buffer 0 is full
 
-	// Configure acceptance filters
-	C1RXF0SIDbits.EXIDE = 0; 			// Enable filter for standard identifier
-	C1RXF0SIDbits.SID = 0b000000000; 	// Accept messages with even identifier
+	/* Rx buffer 1 */
+
+	// General reception configuration
+	C1RX1CONbits.RXFUL = 0; 	// Clear reception full status flag
+
+	/* Acceptance masks and filters */
+	CANSetFilters(rx0_ids, sizeof(rx0_ids)/sizeof(rx0_ids[0]),	// Only messages handled here
+				  rx1_ids, sizeof(rx1_ids)/sizeof(rx1_ids[0]));
 
 	C1CTRLbits.REQOP = 0b000;			// Set normal mode
 	while(C1CTRLbits.OPMODE != 0b000);	// Wait until normal mode
@@ -225,553 +392,499 @@ void CAN_config() {
 void slave1_init() {
 	// Initial paddle coordinates
 	p1x = PAD1_X;
-	p1y = (LENGTH/2) - (PADDLE_L/2);
+	game.p1y = (LENGTH/2) - (PADDLE_L/2);
 	p2x = PAD2_X;
-	p2y = (LENGTH/2) - (PADDLE_L/2);
+	game.p2y = (LENGTH/2) - (PADDLE_L/2);
+	sent_p1y = game.p1y;
 	
 	// Initial ball coordinates
-	bx = p1x + (PADDLE_W) + 1;
-	by = p1y + (PADDLE_L/2);
+	game.bx = p1x + (PADDLE_W) + 1;
+	game.by = game.p1y + (PADDLE_L/2);
 	
-	// Initial scores
-	score[0] = 0;
-	score[1] = 0;
+	// No trajectory received yet
+	game.traj_valid = 0;
 	
-	// Initial previous values at same value
-	pre_bx = bx;
-	pre_by = by;
-	pre_p1y = p1y;
-	pre_p2y = p2y;
+	// Initial scores
+	game.score[0] = 0;
+	game.score[1] = 0;
 }
 
-void clear_screen() {
-	WriteUART1(12);
-	while (BusyUART1()); 		// Wait until the character is transmitted
-	cx = 0; cy = 0;
-}
-
-void move_up() {
-	WriteUART1(27);
-	while (BusyUART1());
-	WriteUART1(91);
-	while (BusyUART1());
-	WriteUART1(65);
-	while (BusyUART1());
-	cy--;
-}
-
-void move_down() {
-	WriteUART1(27);
-	while (BusyUART1());
-	WriteUART1(91);
-	while (BusyUART1());
-	WriteUART1(66);
-	while (BusyUART1());
-	cy++;
-}
-
-void move_left() {
-	WriteUART1(27);
-	while (BusyUART1());
-	WriteUART1(91);
-	while (BusyUART1());
-	WriteUART1(68);
-	while (BusyUART1());
-	cx--;
-}
-
-void move_right() {
-	WriteUART1(27);
-	while (BusyUART1());
-	WriteUART1(91);
-	while (BusyUART1());
-	WriteUART1(67);
-	while (BusyUART1());
-	cx++;
-}
-
-void draw_fill() {
-	putsUART1(FILL);
-	while (BusyUART1());
-	cx++;
-}
-
-void draw_ball() {
-	putsUART1(BALL);
-	while (BusyUART1());
-	cx++;
-}
-
-void position_cursor(unsigned int x, unsigned int y) {
-	while (cx < x) {
-		move_right();
-	}
-	while (cx > x) {
-		move_left();
+// Handlers of the messages that change the game state
+const ProtoHandler handlers[PROTO_COUNT] = {
+	[PROTO_IDX_M_BALL] = ball_received,
+	[PROTO_IDX_M_TRAJ] = traj_received,
+	[PROTO_IDX_M_POINT] = point_received,
+	[PROTO_IDX_S2_PADDLE] = paddle2_received,
+};
+// Handlers of the messages that only write to the terminal
+const ProtoHandler output_handlers[PROTO_COUNT] = {
+	[PROTO_IDX_M_BOUNCE] = bounce_received,
+	[PROTO_IDX_STATS_DUMP] = stats_received,
+};
+
+/* Applies the messages received since the last call to the game state, one at
+ * a time with the UART rx interrupt disabled: it is the other writer, and the
+ * CAN interrupt stays free to take the next frames meanwhile. The messages that
+ * only write to the terminal are handled outside, so UartTxPut can wait for
+ * room without holding the UART rx interrupt off.
+ */
+void process_messages() {
+	CANFrame frame;
+	
+	while (CANRecv(&frame)) {
+		TRACE_LOG(TR_CAN_RX, frame.id);
+		if (!proto_dispatch(output_handlers, &frame)) {
+			IEC0bits.U1RXIE = 0;
+			SeqWriteBegin(&game_seq);
+			proto_dispatch(handlers, &frame);
+			SeqWriteEnd(&game_seq);
+			IEC0bits.U1RXIE = 1;
+		}
+		LAT_DROP(LAT_RXISR);		// Not a trajectory or a paddle, not followed
 	}
-	while (cy < y)  {
-		move_down();
+}
+
+/* Copies the game state, again if the UART rx interrupt changed it meanwhile,
+ * so the copy never mixes old and new values
+ */
+void read_state(GameState *copy) {
+	unsigned int start;
+	
+	do {
+		start = SeqReadBegin(&game_seq);
+		SeqCopy(copy, &game, sizeof(game));
+	} while (SeqReadRetry(&game_seq, start));
+}
+
+/* Handles the events posted by the interrupts since the last call, the output
+ * they need goes out between frames instead of inside the interrupts
+ */
+void process_events() {
+	Event event;
+	
+	while (EvqGet(&event)) {
+		TRACE_LOG(TR_EVENT, (event.type << 8) | event.arg);
+		switch (event.type) {
+			case EV_SERVE:
+				PROTO_SEND(S1_SERVICE);
+				TRACE_LOG(TR_CAN_TX, S1_SERVICE);
+				break;
+			case EV_REPORT:
+				toggle_report(event.arg);
+				break;
+		}
 	}
-	while (cy > y)  {
-		move_up();
+}
+
+/* Sends the own paddle position if the keys moved it, once per PADDLE_MS at
+ * most, so auto-repeat costs one frame per period however many keys arrive
+ */
+void send_paddle() {
+	if (view.p1y == sent_p1y) {
+		LAT_DROP(LAT_KEY);			// Keys against the edge move nothing
+		return;
 	}
-}
-
-void reset_cursor() {
-	while (cx > 0) {
-		move_left();
-	}
-	while (cy > 0) {
-		move_up();
-	}
-}
+	if ((unsigned int)(ms - paddle_time) < PADDLE_MS) return;
+	
+	paddle_time = ms;
+	sent_p1y = view.p1y;
+	p1_seq++;
+	PROTO_SEND(S1_PADDLE, sent_p1y, p1_seq);
+	LAT_MARK(LAT_QUEUED, LAT_KEY);
+	TRACE_LOG(TR_CAN_TX, S1_PADDLE);
+}
 
-void draw_screen() {
-	int i, j;
-	// Clear screen and reset cursor
-	clear_screen();
+/* Updates the longest duration of an interrupt that started at Timer1 count
+ * start, with the Timer1 interrupt flag as it was then (pending)
+ */
+void isr_time(unsigned int *max, unsigned int start, unsigned char pending) {
+	unsigned int now = TMR1;
 	
-	// Draw player 1 paddle
-	position_cursor(p1x, p1y);
-	for (i = 0; i < PADDLE_L; i++) {
-		for (j = 0; j < PADDLE_W; j++) {
-			draw_fill();
-		}
-		for (j = 0; j < PADDLE_W; j++) {
-			move_left();
-		}
-		move_down();
+	// Timer1 restarted meanwhile, its interrupt waits for this one to end
+	if (IFS0bits.T1IF && !pending) now += PR1 + 1;
+	if (now - start > *max) *max = now - start;
+}
+
+void ball_received(const CANFrame *frame) {
+	game.bx = M_BALL_x(frame);
+	game.by = M_BALL_y(frame);
+}
+
+void traj_received(const CANFrame *frame) {
+	unsigned int tick = M_TRAJ_tick(frame);
+	
+	// Ignore trajectories older than the current one
+	if (game.traj_valid && PROTO_SEQ_OLD(tick, game.traj_tick)) return;
+	
+	game.traj_valid = 1;
+	game.traj_x = M_TRAJ_x(frame);
+	game.traj_y = M_TRAJ_y(frame);
+	game.traj_vx = PROTO_SIGNED(PROTO_LO(M_TRAJ_vel(frame)));
+	game.traj_vy = PROTO_SIGNED(PROTO_HI(M_TRAJ_vel(frame)));
+	game.traj_tick = tick;
+	game.traj_time = ms;
+	LAT_MARK(LAT_RX, LAT_RXISR);
+}
+
+/* Places the ball where the last trajectory of the view predicts it, or where
+ * the last M_BALL put it if there is no trajectory
+ */
+void extrapolate_ball() {
+	long ticks;
+	int x, y;
+	
+	if (!view.traj_valid) {
+		bx = view.bx;
+		by = view.by;
+		return;
 	}
 	
-	// Draw player 2 paddle
-	position_cursor(p2x, p2y);
-	for (i = 0; i < PADDLE_L; i++) {
-		for (j = 0; j < PADDLE_W; j++) {
-			draw_fill();
-		}
-		for (j = 0; j < PADDLE_W; j++) {
-			move_left();
-		}
-		move_down();
+	// Rounded to the nearest cell
+	ticks = (ms - view.traj_time) / PROTO_TICK_MS;
+	x = FIX_CELL(view.traj_x + view.traj_vx*ticks);
+	y = FIX_CELL(view.traj_y + view.traj_vy*ticks);
+	
+	// Never draw outside the field if the next trajectory is late
+	if (x < 0) x = 0;
+	else if (x > WIDTH) x = WIDTH;
+	if (y < 0) y = 0;
+	else if (y > LENGTH) y = LENGTH;
+	
+	bx = x;
+	by = y;
+}
+
+void bounce_received(const CANFrame *frame) {
+	TermBell(7);			// Buzzer character back to the UART
+}
+
+void point_received(const CANFrame *frame) {
+	unsigned int winner = M_POINT_winner(frame);
+	
+	if (winner != 1 && winner != 2) return;		// Not a player
+	game.score[winner-1] = (game.score[winner-1] + 1) % SCORE_MAX;
+}
+
+void paddle2_received(const CANFrame *frame) {
+	unsigned int seq = S2_PADDLE_seq(frame);
+	
+	// Overtaken by a newer position
+	if (PROTO_SEQ_OLD(seq, p2_seq)) return;
+	p2_seq = seq;
+	game.p2y = S2_PADDLE_y(frame);
+	LAT_MARK(LAT_RX, LAT_RXISR);
+}
+
+/* Counter of the master, written under the others if the counters are shown
+ */
+void stats_received(const CANFrame *frame) {
+	unsigned int counter = STATS_DUMP_counter(frame);
+	
+	if (reporting != COUNTERS) return;
+	print_counter(PROTO_HI(counter), PROTO_LO(counter),
+				  STATS_DUMP_value_lo(frame) | ((unsigned long)STATS_DUMP_value_hi(frame) << 16));
+}
+
+void clear_screen() {
+	unsigned int i;
+	
+	ScreenClear();
+	for (i = 0; i < SCORE_DIGITS; i++) {
+		score_digits[0][i] = DIGIT_NONE;
+		score_digits[1][i] = DIGIT_NONE;
 	}
+}
+
+void draw_screen() {
+	PROF_ENTER(PROF_DRAW);
+	// Clear screen
+	clear_screen();
 	
-	// Draw player 1 scoreboard
-	position_cursor(SCORE1_X, SCORE_Y);
-	draw_number(score[0]);
+	// Draw the paddles
+	ScreenFill(p1x, view.p1y, PADDLE_W, PADDLE_L, SCREEN_FILL);
+	ScreenFill(p2x, view.p2y, PADDLE_W, PADDLE_L, SCREEN_FILL);
 	
-	// Draw player 2 scoreboard
-	position_cursor(SCORE2_X, SCORE_Y);
-	draw_number(score[1]);
+	// Draw the scoreboards
+	redraw_score(0);
+	redraw_score(1);
 	
 	// Draw ball
-	position_cursor(bx, by);
-	draw_ball();
+	ScreenSprite(bx, by, SCREEN_BALL);
+	ScreenFlush(SCREEN_NO_LIMIT);
 	
 	//Restore preview values
 	pre_bx = bx;
 	pre_by = by;
-	pre_p1y = p1y;
-	pre_p2y = p2y;
-}
-
-void draw_number(unsigned int number) {
-	switch (number) {
-		// ####
-		// #  #
-		// #  #
-		// #  #
-		// ####
-		case 0:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		case 1:
-				move_right();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		// #
-		// ####
-		case 2:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		//    #
-		// ####
-		case 3:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #  #
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 4:
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
-		// ####
-		// #
-		// ####
-		//    #
-		// ####
-		case 5:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #
-		// #
-		// ####
-		// #  #
-		// ####
-		case 6:
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		//    #
-		//    #
-		//    #
-		case 7:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		// #  #
-		// ####
-		case 8:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 9:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
+	pre_p1y = view.p1y;
+	pre_p2y = view.p2y;
+	pre_score[0] = view.score[0];
+	pre_score[1] = view.score[1];
+	PROF_EXIT(PROF_DRAW);
+}
+
+/* Returns 1 if the ball, a paddle or a score changed since the last call
+ */
+unsigned char state_changed() {
+	static unsigned int seen_bx, seen_by, seen_p1y, seen_p2y, seen_score;
+	unsigned int new_score = view.score[0] + view.score[1];
+	unsigned char changed;
+	
+	changed = seen_bx != bx || seen_by != by || seen_p1y != view.p1y ||
+			  seen_p2y != view.p2y || seen_score != new_score;
+	seen_bx = bx;
+	seen_by = by;
+	seen_p1y = view.p1y;
+	seen_p2y = view.p2y;
+	seen_score = new_score;
+	return changed;
+}
+
+/* Draws what changed in the view since the last frame and sends the cells that changed:
+ * the paddle rows that moved, the scoreboards after a point and the ball, shown
+ * over the screen so it doesn't erase what it goes over. Sends budget bytes at
+ * most, the cells left are sent by the next frame
+ */
+void update_screen(unsigned int budget) {
+	unsigned long bytes = TermBytes(), saved = TermSaved();
+	unsigned int i;
+	PROF_ENTER(PROF_UPDATE);
+	
+	// Paddles
+	if (view.p1y != pre_p1y) {
+		move_paddle(p1x, pre_p1y, view.p1y);
+		pre_p1y = view.p1y;
+	}
+	if (view.p2y != pre_p2y) {
+		move_paddle(p2x, pre_p2y, view.p2y);
+		pre_p2y = view.p2y;
+	}
+	
+	// Scoreboards
+	for (i = 0; i < 2; i++) {
+		if (view.score[i] == pre_score[i]) continue;
+		redraw_score(i);
+		pre_score[i] = view.score[i];
+	}
+	
+	// Ball
+	pre_bx = bx;
+	pre_by = by;
+	ScreenSprite(pre_bx, pre_by, SCREEN_BALL);
+	
+	ScreenFlush(budget);
+	frame_bytes = TermBytes() - bytes;
+	frame_saved = TermSaved() - saved;
+	total_bytes += frame_bytes;
+	total_saved += frame_saved;
+	PROF_EXIT(PROF_UPDATE);
+}
+
+/* Draws or erases the rows first to last-1 of the paddle at column x
+ * fill: 1 to draw, 0 to erase
+ */
+void draw_paddle_rows(unsigned int x, unsigned int first, unsigned int last, unsigned char fill) {
+	if (last > first) ScreenFill(x, first, PADDLE_W, last - first, fill ? SCREEN_FILL : SCREEN_BLANK);
+}
+
+/* Moves a paddle erasing the rows it leaves and drawing the rows it enters
+ * x: paddle column
+ * old_y: top row drawn
+ * new_y: new top row
+ */
+void move_paddle(unsigned int x, unsigned int old_y, unsigned int new_y) {
+	if (new_y > old_y) {
+		draw_paddle_rows(x, old_y, (new_y < old_y+PADDLE_L) ? new_y : old_y+PADDLE_L, 0);
+		draw_paddle_rows(x, (new_y > old_y+PADDLE_L) ? new_y : old_y+PADDLE_L, new_y+PADDLE_L, 1);
+	} else {
+		draw_paddle_rows(x, (old_y > new_y+PADDLE_L) ? old_y : new_y+PADDLE_L, old_y+PADDLE_L, 0);
+		draw_paddle_rows(x, new_y, (old_y < new_y+PADDLE_L) ? old_y : new_y+PADDLE_L, 1);
+	}
+}
+
+/* Draws the digits of a scoreboard that changed since it was drawn, so a point
+ * costs one digit most of the time and never more than SCORE_DIGITS
+ * player: 0-1
+ */
+void redraw_score(unsigned int player) {
+	unsigned char digits[SCORE_DIGITS], digit;
+	unsigned int number = view.score[player], count = 0, i, x;
+	
+	// Digits of the number without leading zeros, aligned to the centre side
+	for (i = 0; i < SCORE_DIGITS; i++) digits[i] = DIGIT_NONE;
+	do {
+		digits[SCORE_DIGITS-1 - count] = number % 10;
+		number /= 10;
+		count++;
+	} while (number > 0 && count < SCORE_DIGITS);
+	
+	for (i = 0; i < SCORE_DIGITS; i++) {
+		if (player == 0) {
+			digit = digits[i];
+			x = SCORE1_X - (SCORE_DIGITS-1 - i)*DIGIT_STEP;
+		} else {
+			digit = (i < count) ? digits[SCORE_DIGITS - count + i] : DIGIT_NONE;
+			x = SCORE2_X + i*DIGIT_STEP;
+		}
+		if (digit == score_digits[player][i]) continue;
+		
+		score_digits[player][i] = digit;
+		if (digit == DIGIT_NONE) {
+			ScreenFill(x, SCORE_Y, GLYPH_COLS, GLYPH_ROWS, SCREEN_BLANK);
+		} else {
+			GlyphDraw(digit, x, SCORE_Y, draw_span);
+		}
 	}
 }
+
+/* Draws a run of a digit on the screen, background included so the previous
+ * digit is erased
+ */
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill) {
+	ScreenFill(x, y, len, 1, fill ? SCREEN_FILL : SCREEN_BLANK);
+}
+
+/* Shows the report asked by a key instead of the game, or the game again if a
+ * report is on the terminal. The game isn't drawn meanwhile. Only the reports
+ * compiled in are shown.
+ */
+void toggle_report(unsigned char key) {
+	if (reporting) {
+		reporting = 0;
+		draw_screen();
+		return;
+	}
+	TermSetCellReader(0);			// The game cells aren't under a report
+#ifdef LATENCY
+	if (key == REPORT) {
+		reporting = key;
+		TermClear();
+		print_latency();
+	}
+#endif
+#ifdef TRACE
+	if (key == DUMP) {
+		reporting = key;
+		TermClear();
+		PROTO_SEND(TRACE_REQ);		// The master dumps its own over the CAN
+		TraceDump(UartTxPut);
+	}
+#endif
+#ifdef PROFILE
+	if (key == CYCLES) {
+		reporting = key;
+		TermClear();
+		PROTO_SEND(PROF_REQ);		// The master sends its own over the CAN
+		print_profile();
+	}
+#endif
+	if (key == COUNTERS) {
+		reporting = key;
+		TermClear();
+		PROTO_SEND(STATS_REQ);		// The master sends its own over the CAN
+		print_stats();
+	}
+}
+
+/* Writes the latencies of the stages seen by this node in microseconds
+ */
+void print_latency() {
+#ifdef LATENCY
+	static const char *const names[LAT_STAGES] = {
+		"tick", "key", "key>queued", "queued>sent", "rxisr", "rxisr>rx", "rx>render",
+		"render>out"
+	};
+	LatSummary summary;
+	unsigned char stage;
+	
+	TermPuts("latency (us)      count     p50     p99     max");
+	for (stage = 0; stage < LAT_STAGES; stage++) {
+		LatReport(stage, &summary);
+		if (summary.count == 0) continue;
+		TermGoto(0, TermY() + 1);
+		TermPuts(names[stage]);
+		TermGoto(16, TermY());
+		put_number(summary.count, 8);
+		put_number(summary.p50 * 10 / (FCY/100000), 8);
+		put_number(summary.p99 * 10 / (FCY/100000), 8);
+		put_number(summary.max * 10 / (FCY/100000), 8);
+	}
+#endif
+}
+
+/* Writes the cycles taken by the code profiled on this node
+ */
+void print_profile() {
+#ifdef PROFILE
+	ProfStats stats;
+	unsigned char point;
+	
+	TermPuts("profile (cycles)     count     min     avg       max");
+	for (point = 0; point < PROF_COUNT; point++) {
+		ProfGet(point, &stats);
+		if (stats.count == 0) continue;
+		TermGoto(0, TermY() + 1);
+		TermPuts(ProfName(point));
+		TermGoto(16, TermY());
+		put_number(stats.count, 10);
+		put_number(stats.min, 8);
+		put_number(stats.total / stats.count, 8);
+		put_number(stats.max, 10);
+	}
+#endif
+}
+
+/* Writes the counters of this node, the master's follow on the right as they
+ * arrive
+ */
+void print_stats() {
+	TermPuts(STATS_TITLE);
+	TermGoto(MASTER_STATS_X, 0);
+	TermPuts(STATS_TITLE);
+	stats_row = 0;
+	master_row = 0;
+	print_counter(1, ST_FRAMES_DRAWN, frames_drawn);
+	print_counter(1, ST_FRAMES_DROPPED, frames_dropped);
+	print_counter(1, ST_FRAMES_COALESCED, frames_coalesced);
+	if (frames_drawn > 0) {
+		print_counter(1, ST_FRAME_BYTES, total_bytes / frames_drawn);
+		print_counter(1, ST_FRAME_SAVED, total_saved / frames_drawn);
+	}
+	print_counter(1, ST_C1_ISR_MAX, c1_isr_max);
+	print_counter(1, ST_U1RX_ISR_MAX, u1rx_isr_max);
+	print_counter(1, ST_U1RX_OVERRUNS, u1rx_overruns);
+	print_counter(1, ST_CAN_RX_OVERFLOWS, CANRxOverflows());
+	print_counter(1, ST_CAN_RX_DROPPED, CANRxDropped());
+	print_counter(1, ST_CAN_TX_HIGH, CANTxHighWater());
+	print_counter(1, ST_CAN_TX_DROPPED, CANTxDropped());
+	print_counter(1, ST_UART_TX_HIGH, UartTxHighWater());
+	print_counter(1, ST_UART_TX_STALLS, UartTxStalls());
+	print_counter(1, ST_EVQ_HIGH, EvqHighWater());
+	print_counter(1, ST_EVQ_LOST, EvqLost());
+}
+
+/* Writes a counter of a node on the next line of its column
+ */
+void print_counter(unsigned char node, unsigned char counter, unsigned long value) {
+	unsigned int x = node ? 0 : MASTER_STATS_X;
+	unsigned int *row = node ? &stats_row : &master_row;
+	
+	TermGoto(x, ++*row);
+	TermPuts(StatsName(counter));
+	TermGoto(x + 16, *row);
+	put_number(node, 8);
+	put_number(value, 12);
+}
+
+/* Writes a number right aligned in width characters
+ */
+void put_number(unsigned long number, unsigned int width) {
+	char digits[10];
+	unsigned int n = 0;
+	
+	do {
+		digits[n++] = '0' + number % 10;
+		number /= 10;
+	} while (number);
+	while (width-- > n) TermPutc(' ');
+	while (n) TermPutc(digits[--n]);
+}
@@ -0,0 +1,43 @@
+/* evq.c - Implementación de las funciones de evq.h. */
+#include "evq.h"
+
+#define EVQ_MASK	(EVQ_SIZE - 1)
+
+// Events waiting for the main loop. Single producer (the interrupts, one at a
+// time) and single consumer (main loop): each side only writes its own index.
+static volatile Event events[EVQ_SIZE];
+static volatile unsigned char ev_head, ev_tail;
+// Statistics
+static unsigned int ev_high_water, ev_lost;
+
+unsigned char EvqPost(unsigned char type, unsigned char arg) {
+	unsigned char next = (ev_head + 1) & EVQ_MASK;
+	unsigned int depth;
+
+	if (next == ev_tail) {
+		ev_lost++;
+		return 0;
+	}
+	events[ev_head].type = type;
+	events[ev_head].arg = arg;
+	ev_head = next;				// Publish after the event is written
+	depth = (ev_head - ev_tail) & EVQ_MASK;
+	if (depth > ev_high_water) ev_high_water = depth;
+	return 1;
+}
+
+unsigned char EvqGet(Event *event) {
+	if (ev_tail == ev_head) return 0;
+	event->type = events[ev_tail].type;
+	event->arg = events[ev_tail].arg;
+	ev_tail = (ev_tail + 1) & EVQ_MASK;	// Free the slot after reading it
+	return 1;
+}
+
+unsigned int EvqHighWater() {
+	return ev_high_water;
+}
+
+unsigned int EvqLost() {
+	return ev_lost;
+}
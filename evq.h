@@ -0,0 +1,36 @@
+/* evq.h - Cola de eventos de las interrupciones al bucle principal. */
+#ifndef EVQ_H
+#define EVQ_H
+
+// Queue length in events (power of 2, one slot is kept free)
+#ifndef EVQ_SIZE
+#define EVQ_SIZE	16
+#endif
+
+// Event types. The slaves only post EV_SERVE and EV_REPORT, from the UART rx
+// interrupt: bounces and points reach them as CAN frames handled in the main
+// loop. EV_BOUNCE and EV_POINT are posted by the CAN interrupt of prueba3b.c,
+// which still handles its frames there.
+#define EV_BOUNCE	1			// The ball bounced
+#define EV_POINT	2			// A player scored, arg: winner (1-2)
+#define EV_SERVE	3			// A player asked to serve, arg: player (1-2)
+#define EV_REPORT	4			// A report was asked from the terminal, arg: key
+
+typedef struct {
+	unsigned char type;
+	unsigned char arg;
+} Event;
+
+// Post an event, from interrupts that can't preempt each other (same priority),
+// or from the main loop with the interrupts that post disabled.
+// Never waits: returns 0 and counts the event as lost if the queue is full.
+unsigned char EvqPost(unsigned char type, unsigned char arg);
+
+// Take the oldest event, from the main loop. Returns 0 if there is none.
+unsigned char EvqGet(Event *event);
+
+// Queue statistics
+unsigned int EvqHighWater(void);	// Maximum events waiting
+unsigned int EvqLost(void);			// Events posted with the queue full
+
+#endif
@@ -0,0 +1,12 @@
+/* fix.h - Coordenadas de la pelota en coma fija. */
+#ifndef FIX_H
+#define FIX_H
+
+// Fixed point ball coordinates, in cells with FIX_BITS fractional bits: enough
+// for the slowest ball, a 50th of a cell per tick, and the whole field fits an int
+#define FIX_BITS			8
+#define FIX_ONE				(1 << FIX_BITS)
+#define TO_FIX(c)			((int)(c) << FIX_BITS)
+#define FIX_CELL(v)			(((v) + FIX_ONE/2) >> FIX_BITS)		// Nearest cell
+
+#endif
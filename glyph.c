@@ -0,0 +1,34 @@
+/* glyph.c - Implementación de las funciones de glyph.h. */
+#include "glyph.h"
+
+// Constants are placed in program memory and read through the PSV window
+const unsigned char glyph_digits[10][GLYPH_ROWS] = {
+	{0xF, 0x9, 0x9, 0x9, 0xF},		// 0
+	{0x6, 0x6, 0x6, 0x6, 0x6},		// 1
+	{0xF, 0x1, 0xF, 0x8, 0xF},		// 2
+	{0xF, 0x1, 0xF, 0x1, 0xF},		// 3
+	{0x9, 0x9, 0xF, 0x1, 0x1},		// 4
+	{0xF, 0x8, 0xF, 0x1, 0xF},		// 5
+	{0x8, 0x8, 0xF, 0x9, 0xF},		// 6
+	{0xF, 0x1, 0x1, 0x1, 0x1},		// 7
+	{0xF, 0x9, 0xF, 0x9, 0xF},		// 8
+	{0xF, 0x9, 0xF, 0x1, 0x1},		// 9
+};
+
+void GlyphDraw(unsigned int digit, unsigned int x, unsigned int y, GlyphSpan span) {
+	unsigned int row, col, len;
+	unsigned char bits, fill;
+
+	if (digit > 9) return;
+	for (row = 0; row < GLYPH_ROWS; row++) {
+		bits = glyph_digits[digit][row];
+		for (col = 0; col < GLYPH_COLS; col += len) {
+			// Length of the run of equal cells from col
+			fill = (bits >> (GLYPH_COLS-1 - col)) & 1;
+			for (len = 1; col + len < GLYPH_COLS; len++) {
+				if (((bits >> (GLYPH_COLS-1 - col - len)) & 1) != fill) break;
+			}
+			span(x + col, y + row, len, fill);
+		}
+	}
+}
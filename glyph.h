@@ -0,0 +1,20 @@
+/* glyph.h - Dígitos del marcador como mapas de bits. */
+#ifndef GLYPH_H
+#define GLYPH_H
+
+// Glyph size in cells
+#define GLYPH_COLS		4
+#define GLYPH_ROWS		5
+
+// Rows of the digits 0-9, top first, bit GLYPH_COLS-1 is the leftmost cell
+extern const unsigned char glyph_digits[10][GLYPH_ROWS];
+
+// Draws a run of len cells of row y starting at column x
+// fill: 1 for a run of the digit, 0 for a run of background
+typedef void (*GlyphSpan)(unsigned int x, unsigned int y, unsigned int len, unsigned char fill);
+
+// Draw a digit with its top left cell at x, y, one span per run of equal
+// cells. Background runs may be skipped by the span function.
+void GlyphDraw(unsigned int digit, unsigned int x, unsigned int y, GlyphSpan span);
+
+#endif
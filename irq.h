@@ -0,0 +1,16 @@
+/* irq.h - Secciones críticas elevando la prioridad de la CPU. */
+#ifndef IRQ_H
+#define IRQ_H
+#include <p30f4011.h>
+
+// The simulator serves there the interrupts the raised priority held back
+#ifndef SIM_IPL_LOWERED
+#define SIM_IPL_LOWERED()
+#endif
+
+// Raise the CPU priority to 7 so no user interrupt can preempt, saving the previous one
+#define IRQ_DISABLE(saved)	do { (saved) = SRbits.IPL; SRbits.IPL = 7; } while (0)
+// Restore the CPU priority saved by IRQ_DISABLE
+#define IRQ_RESTORE(saved)	do { SRbits.IPL = (saved); SIM_IPL_LOWERED(); } while (0)
+
+#endif
@@ -0,0 +1,127 @@
+/* lat.c - Implementación de las funciones de lat.h. */
+#include "lat.h"
+#ifdef LATENCY
+#include "irq.h"
+#include "cycles.h"
+
+#define LAT_MASK	(LAT_TRACE - 1)
+
+// Stamp of a stage, from == stage at the start of a chain
+typedef struct {
+	unsigned long time;
+	unsigned char stage, from;
+} LatStamp;
+
+static LatStamp trace[LAT_TRACE];
+static unsigned int trace_head, trace_count;
+// Stages stamped and not yet followed (one bit each)
+static unsigned char open;
+// Set while a report reads the trace
+static volatile unsigned char frozen;
+
+// Walks the latencies of one stage through the trace, oldest first
+typedef struct {
+	unsigned int i;
+	unsigned long last[LAT_STAGES];	// Last stamp of every stage seen so far
+	unsigned char seen;
+} LatScan;
+
+void LatInit() {
+	CyclesInit();
+}
+
+static void stamp(unsigned char stage, unsigned char from) {
+	LatStamp *s;
+
+	if (frozen) return;
+	s = &trace[trace_head];
+	s->time = CyclesRead();
+	s->stage = stage;
+	s->from = from;
+	trace_head = (trace_head + 1) & LAT_MASK;
+	if (trace_count < LAT_TRACE) trace_count++;
+	open |= 1 << stage;
+}
+
+void LatStart(unsigned char stage) {
+	unsigned int ipl;
+
+	IRQ_DISABLE(ipl);
+	if (!(open & (1 << stage))) stamp(stage, stage);
+	IRQ_RESTORE(ipl);
+}
+
+void LatMark(unsigned char stage, unsigned char from) {
+	unsigned int ipl;
+
+	IRQ_DISABLE(ipl);
+	if (open & (1 << from)) {
+		open &= ~(1 << from);
+		stamp(stage, from);
+	}
+	IRQ_RESTORE(ipl);
+}
+
+void LatDrop(unsigned char stage) {
+	unsigned int ipl;
+
+	IRQ_DISABLE(ipl);
+	open &= ~(1 << stage);
+	IRQ_RESTORE(ipl);
+}
+
+/* Next latency of the stage, returns 0 at the end of the trace. A stamp whose
+ * predecessor was overwritten has no latency.
+ */
+static unsigned char scan_next(LatScan *scan, unsigned char stage, unsigned long *latency) {
+	const LatStamp *s;
+	unsigned char found;
+
+	while (scan->i < trace_count) {
+		s = &trace[(trace_head - trace_count + scan->i++) & LAT_MASK];
+		found = s->stage == stage && s->from != stage && (scan->seen & (1 << s->from));
+		if (found) *latency = s->time - scan->last[s->from];
+		scan->last[s->stage] = s->time;
+		scan->seen |= 1 << s->stage;
+		if (found) return 1;
+	}
+	return 0;
+}
+
+/* Smallest latency with at least rank latencies up to it. No room for a sorted
+ * copy: every candidate is counted against the whole trace.
+ */
+static unsigned long rank_value(unsigned char stage, unsigned int rank) {
+	LatScan outer = {0}, inner;
+	unsigned long candidate, other, best = 0xFFFFFFFF;
+	unsigned int below;
+
+	while (scan_next(&outer, stage, &candidate)) {
+		if (candidate >= best) continue;
+		below = 0;
+		inner = (LatScan){0};
+		while (scan_next(&inner, stage, &other)) if (other <= candidate) below++;
+		if (below >= rank) best = candidate;
+	}
+	return best;
+}
+
+void LatReport(unsigned char stage, LatSummary *summary) {
+	LatScan scan = {0};
+	unsigned long latency;
+
+	frozen = 1;
+	summary->count = 0;
+	summary->max = 0;
+	while (scan_next(&scan, stage, &latency)) {
+		summary->count++;
+		if (latency > summary->max) summary->max = latency;
+	}
+	summary->p50 = summary->p99 = 0;
+	if (summary->count) {
+		summary->p50 = rank_value(stage, (summary->count + 1) / 2);
+		summary->p99 = rank_value(stage, ((unsigned long)summary->count * 99 + 99) / 100);
+	}
+	frozen = 0;
+}
+#endif
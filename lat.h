@@ -0,0 +1,57 @@
+/* lat.h - Latencias por etapas desde una tecla o un tick del maestro hasta el terminal. */
+#ifndef LAT_H
+#define LAT_H
+
+// Stages of a change until it is on the other player's terminal. A chain starts
+// at LAT_TICK, LAT_KEY or LAT_RXISR and every other stage follows the one given
+// to LatMark. The latency of a stage is the time since the stage it follows was
+// marked on the same node: LAT_SENT ends on the sender when the bus acknowledges
+// the frame, which is when the receivers get it.
+#define LAT_TICK	0			// Master tick starts
+#define LAT_KEY		1			// Key received by _U1RXInterrupt
+#define LAT_QUEUED	2			// Frame with the change queued for the CAN
+#define LAT_SENT	3			// Frame acknowledged on the bus (tx interrupt)
+#define LAT_RXISR	4			// Frame moved to the rx queue by _C1Interrupt
+#define LAT_RX		5			// Frame applied to the game state by the main loop
+#define LAT_RENDER	6			// Screen frame showing it starts
+#define LAT_OUT		7			// Last byte of that screen frame out of the UART
+#define LAT_STAGES	8
+
+// Stamps kept in the RAM trace (power of 2), the report covers them
+#ifndef LAT_TRACE
+#define LAT_TRACE	64
+#endif
+
+// Latencies of a stage in the trace, in instruction cycles
+typedef struct {
+	unsigned int count;
+	unsigned long p50, p99, max;
+} LatSummary;
+
+#ifdef LATENCY
+// Start the clock of the stamps (cycles.h)
+void LatInit(void);
+// Stamp the start of a chain, unless the last one is still on its way (the
+// oldest change waiting gives the latency)
+void LatStart(unsigned char stage);
+// Stamp a stage if the one it follows is waiting for it
+void LatMark(unsigned char stage, unsigned char from);
+// Forget a stage waiting to be followed, the change it stamped went nowhere
+void LatDrop(unsigned char stage);
+// Summary of a stage from the trace, from the main loop. The trace stops
+// taking stamps meanwhile.
+void LatReport(unsigned char stage, LatSummary *summary);
+
+#define LAT_INIT()				LatInit()
+#define LAT_START(stage)		LatStart(stage)
+#define LAT_MARK(stage, from)	LatMark(stage, from)
+#define LAT_DROP(stage)			LatDrop(stage)
+#else
+// Compiled out: no code and no RAM
+#define LAT_INIT()
+#define LAT_START(stage)
+#define LAT_MARK(stage, from)
+#define LAT_DROP(stage)
+#endif
+
+#endif
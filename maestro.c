@@ -10,6 +10,13 @@
 #include <time.h>
 #include <stdlib.h>
 #include "can.h"
+#include "proto.h"
+#include "irq.h"
+#include "physics.h"
+#include "lat.h"
+#include "trace.h"
+#include "prof.h"
+#include "stats.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -23,38 +30,45 @@ _FGS(CODE_PROT_OFF);
 /* Hardware                                                                   */
 /******************************************************************************/
 
+#define FXT       7372800         // CPU clock
+#define PLL       16              // PLL configuration
+#define FCY       (FXT * PLL) / 4 // Instruction clock
+
 /******************************************************************************/
 /* Constants				                                                  */
 /******************************************************************************/
-#define	WIDTH		80
-#define	LENGTH		24
+#define SERV_NO		0
+#define SERV_YES	1
 
-#define	BALL_L		1
-#define	PADDLE_L	5
-#define PADDLE_W	2
+// Potentiometer hysteresis, in sums of 16 conversions (4 ADC counts)
+#define ADC_HYST	(4*16)
 
-#define	PAD1_X		2
-#define	PAD2_X		76
+// Game tick, the physics run once per tick
+#define TICK_MS		PROTO_TICK_MS
+#define TICK_PR		((FCY/8) / (1000/TICK_MS))	// Timer1 counts per tick (prescaler 1:8)
+// Velocity of a ball that moves one cell every ms milliseconds, fixed point
+// cells per tick
+#define CELL_EVERY(ms)	(FIX_ONE*TICK_MS/(ms))
 
-#define SERV_NO		0
-#define SERV_YES	1
-
-#define	M_BALL		00
-#define	M_BOUNCE	02
-#define	M_POINT		04
-#define	S1_PADDLE	10
-#define	S1_SERVICE	11
-#define	S2_PADDLE	20
-#define	S2_SERVICE	21
+// Maximum slope of the ball after a paddle hit, in quarters (4: 45 degrees)
+#define MAX_SLOPE	4
 
+// 1: send the ball trajectory when it changes and let the slaves extrapolate it
+// 0: send the ball coordinates every tick
+#define DEAD_RECKONING	1
+
 /******************************************************************************/
 /* Global Variable declaration                                                */
 /******************************************************************************/
 // Ball coordenates (Range: 0-WIDTH, 0-LENGTH)
 unsigned int bx, by;
+// Ball position (fixed point cells) and velocity (fixed point cells per tick)
+PhysBall ball;
 // Paddle 1 and 2 top left coordinates (Range: PAD1_X, 0-(LENGTH-PADDLE_L), PAD2_X, 0-(LENGTH-PADDLE_L))
 volatile unsigned int p1x, p1y, p2x, p2y;
-// Ball movement vector (Values: -1.1, -1.1)
+// Sequence number of the last paddle 1 and 2 positions received
+unsigned int p1_seq, p2_seq;
+// Ball horizontal direction (Values: -1.1) and slope in quarters (Range: -MAX_SLOPE-MAX_SLOPE)
 volatile int vector_x, vector_y;
 // Ball speed (Range: 0-4)
 volatile unsigned int speed;
@@ -62,46 +76,66 @@ volatile unsigned int speed;
 volatile unsigned char service;
 // Possession service (Values: 1.2)
 unsigned char pos_service;
+// Horizontal ball velocity at each speed, fixed point cells per tick
+// (one cell every 500, 400, 300, 200 and 100 ms)
+const int speed_vx[5] = {CELL_EVERY(500), CELL_EVERY(400), CELL_EVERY(300), CELL_EVERY(200), CELL_EVERY(100)};
+// Lower limit of every speed band in sums of 16 conversions, the 10-bit range
+// split in 5 equal bands
+const unsigned int speed_edges[6] = {0, 205*16, 410*16, 615*16, 820*16, 1024*16};
+// Ticks signalled by Timer1 and not yet handled
+volatile unsigned char ticks_pending;
+// Scheduler statistics: ticks handled, ticks missed because an update took too
+// long, and delay from the tick to the start of its update (Timer1 counts)
+unsigned long sched_ticks;
+unsigned int sched_overruns;
+unsigned int sched_jitter_min, sched_jitter_max;
+unsigned long sched_jitter_sum;
+// Last trajectory sent to the slaves
+unsigned char traj_sent;
+int traj_x, traj_y, traj_vx, traj_vy;
+unsigned int traj_tick;
+
+// Identifiers of the messages handled by this node: the paddles in rx buffer 0,
+// the requests in rx buffer 1
+const unsigned int rx0_ids[] = {S1_PADDLE, S2_PADDLE};
+const unsigned int rx1_ids[] = {S1_SERVICE, S2_SERVICE, TRACE_REQ, PROF_REQ, STATS_REQ};
 
 /******************************************************************************/
 /* Interrupts                                                                 */
 /******************************************************************************/
 void _ISR _ADCInterrupt(void) {
-	int ADCValue = ADCBUF0;		// get ADC value
-	speed = ((float)ADCValue/1023.0)*4;
+	volatile unsigned int *buf = &ADCBUF0;
+	unsigned int sum = 0, i;
+	PROF_ENTER(PROF_ADC_ISR);
+	
+	// Sum of the 16 conversions (14 bits, 16 times the average)
+	for (i = 0; i < 16; i++) sum += buf[i];
+	TRACE_LOG(TR_ISR_ADC, sum);
+	// Only leave the current speed once the value is past its band by ADC_HYST
+	if (sum < speed_edges[speed] - (speed > 0 ? ADC_HYST : 0) ||
+		sum >= speed_edges[speed+1] + (speed < 4 ? ADC_HYST : 0)) {
+		speed = (sum >> 4) * 5 >> 10;
+	}
 	IFS0bits.ADIF = 0;			// restore ADIF
+	PROF_EXIT(PROF_ADC_ISR);
+}
+
+void _ISR _T1Interrupt() {
+	ticks_pending++;
+	IFS0bits.T1IF = 0;
 }
 
 void _ISR _C1Interrupt() {
-	if (C1INTFbits.RX0IF == 1) {
-		unsigned int id = C1RX0SIDbits.SID;
-		switch (id) {
-			case S1_PADDLE:
-				p1y = C1RX0B1;
-				break;
-			case S1_SERVICE:
-				if (pos_service == 1) {
-					service = SERV_NO;
-					vector_x = 1;
-					vector_y = ((rand() % 2) == 0) ? -1 : 1;
-				}
-				break;
-			case S2_PADDLE:
-				p2y = C1RX0B1;
-				break;
-			case S2_SERVICE:
-				if (pos_service == 2) {
-					service = SERV_NO;
-					vector_x = -1;
-					vector_y = ((rand() % 2) == 0) ? -1 : 1;
-				}
-				break;
-		}
-
-		C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
-		C1INTFbits.RX0IF = 0;
-	}
+	PROF_ENTER(PROF_C1_ISR);
+	
+	TRACE_LOG(TR_ISR_C1, C1INTF);
+	CANRxInterrupt();				// Move the received frames to the rx queue
+#ifdef LATENCY
+	if (C1INTFbits.TX0IF || C1INTFbits.TX1IF || C1INTFbits.TX2IF) LatMark(LAT_SENT, LAT_QUEUED);
+#endif
+	CANTxInterrupt();				// Refill the tx buffers already sent
 	IFS1bits.C1IF = 0;
+	PROF_EXIT(PROF_C1_ISR);
 }
 
 /******************************************************************************/
@@ -109,10 +143,21 @@ void _ISR _C1Interrupt() {
 /******************************************************************************/
 void CAN_config();
 void ADC_config();
+void T1_config();
+unsigned char wait_tick();
 void master_init();
-unsigned char check_paddle_hit();
-unsigned char check_wall_hit();
-int check_point_made();
+void process_messages();
+void send_ball(unsigned int tick);
+void serve_ball();
+void set_velocity();
+int hit_slope(int hit_y, unsigned int paddle_y);
+void paddle1_received(const CANFrame *frame);
+void service1_received(const CANFrame *frame);
+void paddle2_received(const CANFrame *frame);
+void service2_received(const CANFrame *frame);
+void trace_requested(const CANFrame *frame);
+void prof_requested(const CANFrame *frame);
+void stats_requested(const CANFrame *frame);
 
 /******************************************************************************/
 /* Procedures                                                                 */
@@ -123,72 +168,74 @@ int main(void)
 	ADC_config();
 	
 	master_init();
+	T1_config();
+	LAT_INIT();
+	TRACE_INIT(0);
+	PROF_INIT(0);
 	
 	// mode: 0->nothing, 1->bounce, 2->point
-	int mode, winner, i;
-	unsigned int ball_coordinates[2];
+	int mode, winner;
+	// Ticks elapsed since the last update
+	unsigned int ticks;
+	// Events of the ball move and y where it hit a paddle
+	unsigned char events;
+	int hit_y;
+	// Updates done, counted in ticks
+	unsigned int tick = 0;
 	while (1) {
+		// Sleep until the next tick and handle the messages received meanwhile
+		ticks = wait_tick();
+		LAT_START(LAT_TICK);
+		TRACE_LOG(TR_TICK, ticks);
+		process_messages();
+		tick += ticks;
+		
 		mode = 0;
 		winner = 0;
 		
-		// Update ball coordinates
+		// Update ball position, the velocity follows the speed selected.
+		// The move bounces on the walls and paddles it crosses.
+		events = 0;
 		if (service) {
-			if (pos_service == 1) {
-				bx = p1x + (PADDLE_W) + 1;
-				by = p1y + (PADDLE_L/2);
-			} else {
-				bx = p2x - 2;
-				by = p2y + (PADDLE_L/2);
-			}
+			serve_ball();
 		} else {
-			bx += vector_x;
-			by += vector_y;
+			set_velocity();
+			PROF_ENTER(PROF_PHYSICS);
+			events = PhysMove(&ball, p1y, p2y, ticks, &hit_y);
+			PROF_EXIT(PROF_PHYSICS);
 		}
 		
 		// Check bounces
-		unsigned char paddle_bounce = check_paddle_hit();
-		if (paddle_bounce) {
+		if (events & (PHYS_PADDLE1 | PHYS_PADDLE2)) {
 			mode = 1;
-			vector_x = (vector_x == 1) ? -1 : 1;
-			if (bx < (WIDTH/2)) {	// If it bounced with paddle 1
-				if (vector_y == 1 && by < (p1y + (PADDLE_L/2))) vector_y = -1;
-				else if (vector_y == -1 && by > (p1y + (PADDLE_L/2))) vector_y = 1;
-			} else {				// If it bounced with paddle 2
-				if (vector_y == 1 && by < (p2y + (PADDLE_L/2))) vector_y = -1;
-				else if (vector_y == -1 && by > (p2y + (PADDLE_L/2))) vector_y = 1;
-			}
-		}
-		unsigned char wall_bounce = check_wall_hit();
-		if (wall_bounce) {
+			vector_x = (ball.vx < 0) ? -1 : 1;
+			// The slope depends on where the ball hit the paddle, and turns
+			// over if the ball bounced on a wall after the hit
+			vector_y = hit_slope(hit_y, (events & PHYS_PADDLE1) ? p1y : p2y);
+			if (events & PHYS_FLIP) vector_y = -vector_y;
+		} else if (events & PHYS_WALL) {
 			mode = 1;
-			vector_y = (vector_y == -1) ? 1 : -1;
+			vector_y = (ball.vy < 0) ? -abs(vector_y) : abs(vector_y);
 		}
+		if (mode == 1) set_velocity();
+		bx = FIX_CELL(ball.x);
+		by = FIX_CELL(ball.y);
 		
 		// Check if someone has scored
-		winner = check_point_made();
+		if (events & PHYS_GOAL1) winner = 2;
+		else if (events & PHYS_GOAL2) winner = 1;
 		if (winner) {
 			mode = 2;
-			if (winner == 1) {
-				bx = p2x - 1;
-				by = p2y + (PADDLE_L/2) - BALL_L;
-				pos_service = 2;
-			} else {
-				bx = p1x + (PADDLE_W) + 1;
-				by = p1y + (PADDLE_L/2) - BALL_L;
-				pos_service = 1;
-			}
+			pos_service = (winner == 1) ? 2 : 1;
 			service = SERV_YES;
+			serve_ball();
 		}
 		
 		// Send messages
-		if (mode == 1) CANSendMsg(M_BOUNCE, 0, NULL);
-		else if (mode == 2) CANSendMsg(M_POINT, 1, &winner);
-		ball_coordinates[0] = bx;
-		ball_coordinates[1] = by;
-		CANSendMsg(M_BALL, 2, ball_coordinates);
-		
-		// Wait until next update
-		for (i = 0; i < 100-20*speed; i++) Delay5ms();
+		if (mode == 1) PROTO_SEND(M_BOUNCE);
+		else if (mode == 2) PROTO_SEND(M_POINT, winner);
+		send_ball(tick);
+		TRACE_DUMP_CAN_NEXT();
 	}
 	
     return 0;
@@ -221,26 +268,36 @@ void CAN_config() {
 	// Local CAN interrupts
 	C1INTEbits.RX0IE = 1; 		// Enable CAN interrupt associated to rx buffer 0
 	C1INTFbits.RX0IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 0
-	
-	/* Tx buffer 0 */
+	C1INTEbits.RX1IE = 1; 		// Enable CAN interrupt associated to rx buffer 1
+	C1INTFbits.RX1IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 1
+	C1INTEbits.TX0IE = 1; 		// Enable CAN interrupts associated to tx buffers 0-2
+	C1INTEbits.TX1IE = 1;
+	C1INTEbits.TX2IE = 1;
+	C1INTFbits.TX0IF = 0; 		// Clear CAN interrupt flags associated to tx buffers 0-2
+	C1INTFbits.TX1IF = 0;
+	C1INTFbits.TX2IF = 0;
+
+	/* Tx buffers 0-2 */
 
 	// General transmission configuration
-	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flag
+	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flags
+	C1TX1CONbits.TXREQ = 0;
+	C1TX2CONbits.TXREQ = 0;
 
 	/* Rx buffer 0 */
 	
 	// General reception configuration
 	C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
-	C1RX0CONbits.DBEN = 0; 		// Disable double buffer
-
-	// Configure acceptance mask
-	C1RXM0SIDbits.SID = 0; 		// No bits to compare
-	C1RXM0SIDbits.MIDE = 1; 	// Identifier mode as determined by EXIDE
-	C1RX0CONbits.FILHIT0 = 0; 	// Link to acceptance filter 0
+	C1RX0CONbits.DBEN = 1; 		// Overflow into rx buffer 1 when rx buffer 0 is full
 
-	// Configure acceptance filters
-	C1RXF0SIDbits.EXIDE = 0; 	// Enable filter for standard identifier
-	C1RXF0SIDbits.SID = 0; 		// Doesn't matter the value as mask is '0'
+	/* Rx buffer 1 */
+
+	// General reception configuration
+	C1RX1CONbits.RXFUL = 0; 	// Clear reception full status flag
+
+	/* Acceptance masks and filters */
+	CANSetFilters(rx0_ids, sizeof(rx0_ids)/sizeof(rx0_ids[0]),	// Only messages handled here
+				  rx1_ids, sizeof(rx1_ids)/sizeof(rx1_ids[0]));
 
 	C1CTRLbits.REQOP = 0b000;			// Set normal mode
 	while(C1CTRLbits.OPMODE != 0b000);	// Wait until normal mode
@@ -272,6 +329,46 @@ void ADC_config() {
 	IFS0bits.ADIF = 0;		// clear ADIF bit
 }
 
+void T1_config() {
+	T1CON = 0;					// Timer off, internal clock
+	T1CONbits.TCKPS = 0b01;		// Prescaler 1:8
+	TMR1 = 0;
+	PR1 = TICK_PR - 1;			// Period of one tick
+	
+	IEC0bits.T1IE = 1;			// Enable Timer1 interrupt
+	IFS0bits.T1IF = 0;			// Clear Timer1 interrupt flag
+	T1CONbits.TON = 1;			// Start Timer1
+}
+
+/* Idles the CPU until Timer1 signals a tick and updates the scheduler statistics
+ * return: ticks elapsed since the last call (more than 1 if ticks were missed)
+ */
+unsigned char wait_tick() {
+	unsigned int ipl, late;
+	unsigned char ticks;
+	
+	// With the CPU priority raised the interrupts still wake the CPU up, but are
+	// served after restoring it, so a tick can't slip in between the check and Idle()
+	IRQ_DISABLE(ipl);
+	while (ticks_pending == 0) {
+		Idle();
+		IRQ_RESTORE(ipl);
+		IRQ_DISABLE(ipl);
+	}
+	late = TMR1;
+	ticks = ticks_pending;
+	ticks_pending = 0;
+	IRQ_RESTORE(ipl);
+	
+	if (sched_ticks == 0 || late < sched_jitter_min) sched_jitter_min = late;
+	if (late > sched_jitter_max) sched_jitter_max = late;
+	sched_jitter_sum += late;
+	sched_overruns += ticks - 1;
+	sched_ticks += ticks;
+	
+	return ticks;
+}
+
 void master_init() {
 	srand(time(NULL));
 	// Initial service
@@ -284,55 +381,180 @@ void master_init() {
 	p2x = PAD2_X;
 	p2y = (LENGTH/2) - (PADDLE_L/2);
 	
-	// Initial ball coordinates
-	bx = p1x + (PADDLE_W) + 1;
-	by = p1y + (PADDLE_L/2);
-	
 	// Initial ball speed
 	speed = 0;
 	
 	// Initial ball movement vector
 	vector_x = 1;
-	vector_y = ((rand() % 2) == 0) ? -1 : 1;
+	vector_y = ((rand() % 2) == 0) ? -MAX_SLOPE : MAX_SLOPE;
+	
+	// Initial ball coordinates
+	serve_ball();
+	
+	// No trajectory sent yet
+	traj_sent = 0;
+	
+	// No tick yet
+	ticks_pending = 0;
+	sched_ticks = 0;
+	sched_overruns = 0;
+	sched_jitter_min = 0;
+	sched_jitter_max = 0;
+	sched_jitter_sum = 0;
 }
 
-/* Checks if the ball hit a paddle
- * return: 0, if it didn't hit
- * 		   1, otherwise
+// Handlers of the messages received by the master
+const ProtoHandler handlers[PROTO_COUNT] = {
+	[PROTO_IDX_S1_PADDLE] = paddle1_received,
+	[PROTO_IDX_S1_SERVICE] = service1_received,
+	[PROTO_IDX_S2_PADDLE] = paddle2_received,
+	[PROTO_IDX_S2_SERVICE] = service2_received,
+	[PROTO_IDX_TRACE_REQ] = trace_requested,
+	[PROTO_IDX_PROF_REQ] = prof_requested,
+	[PROTO_IDX_STATS_REQ] = stats_requested,
+};
+
+/* Handles the messages received since the last call
  */
-unsigned char check_paddle_hit() {
-	unsigned char hit = 0;
+void process_messages() {
+	CANFrame frame;
 	
-	if (bx <= p1x+PADDLE_W && by >= p1y && by < p1y+PADDLE_L)
-		hit = 1;
-	if (bx >= p2x && by >= p2y && by < p2y+PADDLE_L)
-		hit = 1;
+	while (CANRecv(&frame)) {
+		TRACE_LOG(TR_CAN_RX, frame.id);
+		proto_dispatch(handlers, &frame);
+	}
+}
+
+void paddle1_received(const CANFrame *frame) {
+	unsigned int seq = S1_PADDLE_seq(frame);
+	
+	// Overtaken by a newer position
+	if (PROTO_SEQ_OLD(seq, p1_seq)) return;
+	p1_seq = seq;
+	p1y = S1_PADDLE_y(frame);
+}
+
+void service1_received(const CANFrame *frame) {
+	if (pos_service == 1) {
+		service = SERV_NO;
+		vector_x = 1;
+		vector_y = ((rand() % 2) == 0) ? -MAX_SLOPE : MAX_SLOPE;
+	}
+}
+
+void paddle2_received(const CANFrame *frame) {
+	unsigned int seq = S2_PADDLE_seq(frame);
 	
-	return hit;
+	// Overtaken by a newer position
+	if (PROTO_SEQ_OLD(seq, p2_seq)) return;
+	p2_seq = seq;
+	p2y = S2_PADDLE_y(frame);
 }
 
-/* Checks if the ball hit a wall
- * return: 0, if it didn't hit
- * 		   1, otherwise
+void service2_received(const CANFrame *frame) {
+	if (pos_service == 2) {
+		service = SERV_NO;
+		vector_x = -1;
+		vector_y = ((rand() % 2) == 0) ? -MAX_SLOPE : MAX_SLOPE;
+	}
+}
+
+/* A slave asked for the trace: it goes out over the CAN a few frames per tick
  */
-unsigned char check_wall_hit() {
-	unsigned char hit = 0;
+void trace_requested(const CANFrame *frame) {
+	TRACE_DUMP_CAN();
+}
+
+/* A slave asked for the profile: one frame per point that ran
+ */
+void prof_requested(const CANFrame *frame) {
+	PROF_DUMP_CAN();
+}
+
+/* A slave asked for the counters: they all go out over the CAN at once, the
+ * slaves take them in the double buffered rx buffer 0. The jitter goes in
+ * cycles (Timer1 counts at 1:8), averaged over the updates done.
+ */
+void stats_requested(const CANFrame *frame) {
+	unsigned long updates = sched_ticks - sched_overruns;
 	
-	if (by <= 0 || by >= LENGTH)
-		hit = 1;
+	StatsSendCan(0, ST_SCHED_TICKS, sched_ticks);
+	StatsSendCan(0, ST_SCHED_OVERRUNS, sched_overruns);
+	StatsSendCan(0, ST_JITTER_MIN, sched_jitter_min * 8UL);
+	StatsSendCan(0, ST_JITTER_AVG, updates ? sched_jitter_sum * 8 / updates : 0);
+	StatsSendCan(0, ST_JITTER_MAX, sched_jitter_max * 8UL);
+	StatsSendCan(0, ST_CAN_RX_OVERFLOWS, CANRxOverflows());
+	StatsSendCan(0, ST_CAN_RX_DROPPED, CANRxDropped());
+	StatsSendCan(0, ST_CAN_TX_HIGH, CANTxHighWater());
+	StatsSendCan(0, ST_CAN_TX_DROPPED, CANTxDropped());
+}
+
+/* Places the ball in front of the paddle that has the service, stopped
+ */
+void serve_ball() {
+	if (pos_service == 1) {
+		ball.x = TO_FIX(p1x + (PADDLE_W) + 1);
+		ball.y = TO_FIX(p1y + (PADDLE_L/2));
+	} else {
+		ball.x = TO_FIX(p2x - 2);
+		ball.y = TO_FIX(p2y + (PADDLE_L/2));
+	}
+	ball.vx = 0;
+	ball.vy = 0;
+	bx = FIX_CELL(ball.x);
+	by = FIX_CELL(ball.y);
+}
+
+/* Computes the ball velocity from its direction, slope and the selected speed
+ */
+void set_velocity() {
+	int vx = speed_vx[speed];
+	
+	ball.vx = vector_x*vx;
+	ball.vy = (vector_y*vx) / MAX_SLOPE;
+}
+
+/* Computes the slope of the ball after hitting a paddle: flat from the centre
+ * of the paddle and up to MAX_SLOPE from its ends
+ * hit_y: fixed point y where the ball hit the paddle
+ * paddle_y: top coordinate of the paddle hit
+ * return: slope in quarters
+ */
+int hit_slope(int hit_y, unsigned int paddle_y) {
+	int offset = (int)FIX_CELL(hit_y) - (int)(paddle_y + (PADDLE_L/2));
+	int slope = offset * 2*MAX_SLOPE / (PADDLE_L-1);
 	
-	return hit;
+	if (slope > MAX_SLOPE) slope = MAX_SLOPE;
+	else if (slope < -MAX_SLOPE) slope = -MAX_SLOPE;
+	return slope;
 }
 
-/* Checks if a point was made
- * return: 0, if no point made
- * 		   1-2, the winner
+/* Sends the ball to the slaves
+ * With DEAD_RECKONING the trajectory is only sent when the last one sent no
+ * longer predicts the ball: serve, bounce, point, speed change or the ball
+ * following the paddle before the service.
+ * tick: current tick number
  */
-int check_point_made() {
-	unsigned char point = 0;
+void send_ball(unsigned int tick) {
+#if DEAD_RECKONING
+	long steps = (int)(tick - traj_tick);
 	
-	if (bx <= 0) point = 2;
-	else if (bx >= WIDTH) point = 1;
+	if (traj_sent && ball.vx == traj_vx && ball.vy == traj_vy &&
+		ball.x == traj_x + traj_vx*steps && ball.y == traj_y + traj_vy*steps) {
+		LAT_DROP(LAT_TICK);			// Nothing new for the slaves this tick
+		return;
+	}
 	
-	return point;
-}
+	traj_sent = 1;
+	traj_x = ball.x;
+	traj_y = ball.y;
+	traj_vx = ball.vx;
+	traj_vy = ball.vy;
+	traj_tick = tick;
+	PROTO_SEND(M_TRAJ, ball.x, ball.y, PROTO_PAIR(ball.vx, ball.vy), tick);
+#else
+	PROTO_SEND(M_BALL, bx, by);
+#endif
+	LAT_MARK(LAT_QUEUED, LAT_TICK);
+	TRACE_LOG(TR_CAN_TX, DEAD_RECKONING ? M_TRAJ : M_BALL);
+}
@@ -0,0 +1,132 @@
+/* physics.c - Implementación de las funciones de physics.h. */
+#include "physics.h"
+
+// Planes the ball centre bounces on and goal lines (fixed point)
+#define TOP_Y		0L
+#define BOTTOM_Y	((long)TO_FIX(LENGTH))
+#define FACE1_X		((long)TO_FIX(PAD1_X + PADDLE_W))
+#define FACE2_X		((long)TO_FIX(PAD2_X))
+#define GOAL1_X		0L
+#define GOAL2_X		((long)TO_FIX(WIDTH))
+
+// Bounces handled in a single move, more than the fastest ball can make
+#define MAX_HITS	16
+
+enum { HIT_NONE, HIT_TOP, HIT_BOTTOM, HIT_FACE1, HIT_FACE2 };
+
+/* The move is handled as a straight segment from (x0, y0) at t = 0 to (x1, y1)
+ * at t = 1. A bounce mirrors the whole segment on the plane hit, so the part
+ * after the contact is the reflected path and every crossing time stays an
+ * exact fraction num/den of the original move.
+ */
+
+/* Checks whether a crossing at num/den falls in [t_num/t_den, 1) and before
+ * the best one found so far (best_num/best_den)
+ */
+static unsigned char is_next(long num, long den, long t_num, long t_den,
+							 long best_num, long best_den) {
+	return num * t_den >= t_num * den && num < den && num * best_den < best_num * den;
+}
+
+/* Checks whether the ball crosses a paddle face within the paddle
+ * (the cells py to py+PADDLE_L-1 once rounded)
+ */
+static unsigned char on_paddle(long y0, long y1, long num, long den, unsigned int py) {
+	long y = y0 * den + (y1 - y0) * num;	// Contact y scaled by den
+	long top = (long)TO_FIX(py) - FIX_ONE/2;
+	long bottom = (long)TO_FIX(py + PADDLE_L) - FIX_ONE/2;
+
+	return y >= top * den && y < bottom * den;
+}
+
+unsigned char PhysMove(PhysBall *ball, unsigned int p1y, unsigned int p2y,
+					   unsigned int ticks, int *hit_y) {
+	long x0 = ball->x, y0 = ball->y;
+	long x1 = x0 + (long)ball->vx * ticks;
+	long y1 = y0 + (long)ball->vy * ticks;
+	long t_num = 0, t_den = 1;		// Time of the last bounce
+	long num, den, best_num, best_den;
+	unsigned char hit, n, events = 0;
+
+	for (n = 0; n < MAX_HITS; n++) {
+		// Earliest crossing towards a plane after the last bounce
+		hit = HIT_NONE;
+		best_num = 1;
+		best_den = 1;
+		if (y1 < y0) {
+			num = y0 - TOP_Y;
+			den = y0 - y1;
+			if (is_next(num, den, t_num, t_den, best_num, best_den)) {
+				hit = HIT_TOP; best_num = num; best_den = den;
+			}
+		} else if (y1 > y0) {
+			num = BOTTOM_Y - y0;
+			den = y1 - y0;
+			if (is_next(num, den, t_num, t_den, best_num, best_den)) {
+				hit = HIT_BOTTOM; best_num = num; best_den = den;
+			}
+		}
+		if (x1 < x0) {
+			num = x0 - FACE1_X;
+			den = x0 - x1;
+			if (is_next(num, den, t_num, t_den, best_num, best_den) &&
+				on_paddle(y0, y1, num, den, p1y)) {
+				hit = HIT_FACE1; best_num = num; best_den = den;
+			}
+		} else if (x1 > x0) {
+			num = FACE2_X - x0;
+			den = x1 - x0;
+			if (is_next(num, den, t_num, t_den, best_num, best_den) &&
+				on_paddle(y0, y1, num, den, p2y)) {
+				hit = HIT_FACE2; best_num = num; best_den = den;
+			}
+		}
+		if (hit == HIT_NONE) break;
+
+		// Mirror the segment on the plane hit
+		switch (hit) {
+			case HIT_TOP:
+				y0 = 2*TOP_Y - y0;
+				y1 = 2*TOP_Y - y1;
+				ball->vy = -ball->vy;
+				events = (events ^ PHYS_FLIP) | PHYS_WALL;
+				break;
+			case HIT_BOTTOM:
+				y0 = 2*BOTTOM_Y - y0;
+				y1 = 2*BOTTOM_Y - y1;
+				ball->vy = -ball->vy;
+				events = (events ^ PHYS_FLIP) | PHYS_WALL;
+				break;
+			case HIT_FACE1:
+			case HIT_FACE2:
+				*hit_y = (y0 * best_den + (y1 - y0) * best_num) / best_den;
+				if (hit == HIT_FACE1) {
+					x0 = 2*FACE1_X - x0;
+					x1 = 2*FACE1_X - x1;
+					events |= PHYS_PADDLE1;
+				} else {
+					x0 = 2*FACE2_X - x0;
+					x1 = 2*FACE2_X - x1;
+					events |= PHYS_PADDLE2;
+				}
+				ball->vx = -ball->vx;
+				events &= ~PHYS_FLIP;
+				break;
+		}
+		t_num = best_num;
+		t_den = best_den;
+	}
+
+	if (!(events & (PHYS_PADDLE1 | PHYS_PADDLE2))) events &= ~PHYS_FLIP;
+
+	// Never leave the field if the move had more bounces than handled
+	if (y1 < TOP_Y) y1 = TOP_Y;
+	else if (y1 > BOTTOM_Y) y1 = BOTTOM_Y;
+
+	if (x1 <= GOAL1_X) events |= PHYS_GOAL1;
+	else if (x1 >= GOAL2_X) events |= PHYS_GOAL2;
+
+	ball->x = x1;
+	ball->y = y1;
+	return events;
+}
@@ -0,0 +1,43 @@
+/* physics.h - Movimiento de la pelota con detección continua de colisiones. */
+#ifndef PHYSICS_H
+#define PHYSICS_H
+#include "fix.h"
+
+/******************************************************************************/
+/* Field                                                                      */
+/******************************************************************************/
+#define	WIDTH		80
+#define	LENGTH		24
+
+#define	BALL_L		1
+#define	PADDLE_L	5
+#define PADDLE_W	2
+
+#define	PAD1_X		2
+#define	PAD2_X		76
+
+// Events of a move, combined with |
+#define PHYS_WALL		0x01	// Bounced on the top or bottom wall
+#define PHYS_PADDLE1	0x02	// Bounced on the face of paddle 1
+#define PHYS_PADDLE2	0x04	// Bounced on the face of paddle 2
+#define PHYS_GOAL1		0x08	// Ended behind the goal line of player 1 (player 2 scores)
+#define PHYS_GOAL2		0x10	// Ended behind the goal line of player 2 (player 1 scores)
+#define PHYS_FLIP		0x20	// Odd number of wall bounces after the last paddle contact
+
+// Ball state
+typedef struct {
+	int x, y;		// Position, fixed point cells
+	int vx, vy;		// Velocity, fixed point cells per tick
+} PhysBall;
+
+// Move the ball 'ticks' ticks along its velocity. The whole segment is tested
+// against the walls and the paddle faces, so a fast ball can't go through a
+// paddle: at every hit the ball continues from the contact point with the
+// velocity reflected. p1y and p2y are the paddle top cells. The y of the last
+// paddle contact is stored in *hit_y (fixed point) if a paddle was hit.
+// The move must be shorter than 128 cells.
+// return: the PHYS_ events of the move
+unsigned char PhysMove(PhysBall *ball, unsigned int p1y, unsigned int p2y,
+					   unsigned int ticks, int *hit_y);
+
+#endif
@@ -0,0 +1,66 @@
+/* prof.c - Implementación de las funciones de prof.h. */
+#include "prof.h"
+#ifdef PROFILE
+#include "proto.h"
+
+#define PROF_NAME(id, name)		name,
+static const char *const names[PROF_COUNT] = { PROF_POINTS(PROF_NAME) };
+
+static ProfStats stats[PROF_COUNT];
+// Cycles of an empty enter and exit
+static unsigned long overhead;
+static unsigned char prof_node;
+
+void ProfInit(unsigned char node) {
+	unsigned long start;
+
+	prof_node = node;
+	CyclesInit();
+	start = ProfNow();
+	overhead = ProfNow() - start;
+}
+
+void ProfRecord(unsigned char point, unsigned long start) {
+	unsigned long cycles = ProfNow() - start;
+	ProfStats *s = &stats[point];
+	unsigned int ipl;
+
+	cycles = (cycles > overhead) ? cycles - overhead : 0;
+	IRQ_DISABLE(ipl);
+	if (s->count == 0 || cycles < s->min) s->min = cycles;
+	if (cycles > s->max) s->max = cycles;
+	s->total += cycles;
+	s->count++;
+	IRQ_RESTORE(ipl);
+}
+
+void ProfGet(unsigned char point, ProfStats *copy) {
+	unsigned int ipl;
+
+	IRQ_DISABLE(ipl);
+	*copy = stats[point];
+	IRQ_RESTORE(ipl);
+}
+
+const char *ProfName(unsigned char point) {
+	return names[point];
+}
+
+/* 16-bit fields of the frames, saturated
+ */
+static unsigned int word(unsigned long value) {
+	return (value > 0xFFFF) ? 0xFFFF : value;
+}
+
+void ProfDumpCan() {
+	ProfStats s;
+	unsigned char point;
+
+	for (point = 0; point < PROF_COUNT; point++) {
+		ProfGet(point, &s);
+		if (s.count == 0) continue;
+		PROTO_SEND(PROF_DUMP, PROTO_PAIR(point, prof_node), word(s.count),
+				   word(s.total / s.count), word(s.max));
+	}
+}
+#endif
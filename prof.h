@@ -0,0 +1,66 @@
+/* prof.h - Ciclos de las interrupciones y funciones medidos con el reloj de cycles.h. */
+#ifndef PROF_H
+#define PROF_H
+#include "irq.h"
+#include "cycles.h"
+
+// Code measured: X(identifier, name in the reports)
+#define PROF_POINTS(X) \
+	X(PROF_C1_ISR,		"_C1Interrupt") \
+	X(PROF_U1RX_ISR,	"_U1RXInterrupt") \
+	X(PROF_ADC_ISR,		"_ADCInterrupt") \
+	X(PROF_DRAW,		"draw_screen") \
+	X(PROF_UPDATE,		"update_screen") \
+	X(PROF_PHYSICS,		"PhysMove") \
+	X(PROF_CAN_SEND,	"CANSendFrame") \
+	X(PROF_CAN_SEND_B,	"CANSendBMsg")
+
+#define PROF_ID(id, name)	id,
+enum { PROF_POINTS(PROF_ID) PROF_COUNT };
+
+// Cycles from enter to exit, the cost of the measure taken out. Code of the
+// main loop also counts the interrupts that preempt it.
+typedef struct {
+	unsigned long count, total, min, max;
+} ProfStats;
+
+#ifdef PROFILE
+// Start the clock (cycles.h) and measure the cost of an empty enter and exit,
+// node goes in the dumps
+void ProfInit(unsigned char node);
+
+// Clock read with the interrupts masked, so any code can take it
+static inline unsigned long ProfNow(void) {
+	unsigned int ipl;
+	unsigned long now;
+
+	IRQ_DISABLE(ipl);
+	now = CyclesRead();
+	IRQ_RESTORE(ipl);
+	return now;
+}
+
+// Add a run of a point that started at start (ProfNow)
+void ProfRecord(unsigned char point, unsigned long start);
+
+// Consistent copy of the figures of a point, and its name
+void ProfGet(unsigned char point, ProfStats *stats);
+const char *ProfName(unsigned char point);
+
+// Send the figures of every point that ran as PROF_DUMP frames
+void ProfDumpCan(void);
+
+// Around the code of a point, in the same block
+#define PROF_INIT(node)			ProfInit(node)
+#define PROF_ENTER(point)		unsigned long prof_##point = ProfNow()
+#define PROF_EXIT(point)		ProfRecord(point, prof_##point)
+#define PROF_DUMP_CAN()			ProfDumpCan()
+#else
+// Compiled out: no code and no RAM
+#define PROF_INIT(node)
+#define PROF_ENTER(point)
+#define PROF_EXIT(point)
+#define PROF_DUMP_CAN()
+#endif
+
+#endif
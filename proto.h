@@ -0,0 +1,130 @@
+/* proto.h - Definición única de los mensajes CAN entre el maestro y los esclavos. */
+#ifndef PROTO_H
+#define PROTO_H
+#include "can.h"
+#include "fix.h"
+
+/******************************************************************************/
+/* Message table                                                              */
+/******************************************************************************/
+// X(name, identifier, payload layout)
+#define PROTO_MESSAGES(X) \
+	X(M_BALL,		0,	BALL_FIELDS) \
+	X(M_BOUNCE,		2,	NO_FIELDS) \
+	X(M_POINT,		4,	POINT_FIELDS) \
+	X(M_TRAJ,		6,	TRAJ_FIELDS) \
+	X(S1_PADDLE,	10,	PADDLE_FIELDS) \
+	X(S1_SERVICE,	11,	NO_FIELDS) \
+	X(S2_PADDLE,	20,	PADDLE_FIELDS) \
+	X(S2_SERVICE,	21,	NO_FIELDS) \
+	X(TRACE_REQ,	30,	NO_FIELDS) \
+	X(TRACE_DUMP,	31,	TRACE_FIELDS) \
+	X(PROF_REQ,		32,	NO_FIELDS) \
+	X(PROF_DUMP,	33,	PROF_FIELDS) \
+	X(STATS_REQ,	34,	NO_FIELDS) \
+	X(STATS_DUMP,	35,	STATS_FIELDS)
+
+// Payload layouts, one 16-bit word per field in order: F(message, type, field)
+#define NO_FIELDS(F, m)
+#define BALL_FIELDS(F, m)	F(m, unsigned int, x) F(m, unsigned int, y)	// Ball coordinates
+#define POINT_FIELDS(F, m)	F(m, unsigned int, winner)					// Player who scored (1-2)
+// Paddle top coordinate and update number, the receiver ignores older updates
+#define PADDLE_FIELDS(F, m)	F(m, unsigned int, y) F(m, unsigned int, seq)
+// Ball trajectory: fixed point position (x, y) and velocity per tick (signed x, y
+// bytes) at master tick 'tick', a tick lasting PROTO_TICK_MS ms
+#define TRAJ_FIELDS(F, m)	F(m, int, x) F(m, int, y) \
+							F(m, unsigned int, vel) F(m, unsigned int, tick)
+// Trace entry (trace.h) of a node dumping its ring after a TRACE_REQ: time in
+// cycles, event (low byte) and node (high byte), argument
+#define TRACE_FIELDS(F, m)	F(m, unsigned int, time_lo) F(m, unsigned int, time_hi) \
+							F(m, unsigned int, event) F(m, unsigned int, arg)
+// Profiled point (prof.h) of a node answering a PROF_REQ: point (low byte) and
+// node (high byte), runs, average and maximum cycles, saturated to 16 bits
+#define PROF_FIELDS(F, m)	F(m, unsigned int, point) F(m, unsigned int, count) \
+							F(m, unsigned int, avg) F(m, unsigned int, max)
+// Counter (stats.h) of a node answering a STATS_REQ: counter (low byte) and
+// node (high byte), 32-bit value
+#define STATS_FIELDS(F, m)	F(m, unsigned int, counter) F(m, unsigned int, value_lo) \
+							F(m, unsigned int, value_hi)
+
+// Game tick of the master, the period of the M_TRAJ ticks
+#define PROTO_TICK_MS		10
+
+// Two bytes sharing one payload word
+#define PROTO_PAIR(lo, hi)	(((unsigned int)(lo) & 0xFF) | (((unsigned int)(hi) & 0xFF) << 8))
+#define PROTO_LO(w)			((w) & 0xFF)
+#define PROTO_HI(w)			((w) >> 8)
+#define PROTO_SIGNED(b)		((int)(signed char)(b))
+
+// Sequence numbers: true if seq is older than last, unless it is so much older
+// that the sender restarted
+#define PROTO_SEQ_WINDOW	256
+#define PROTO_SEQ_OLD(seq, last) \
+	((int)((seq) - (last)) < 0 && (int)((seq) - (last)) > -PROTO_SEQ_WINDOW)
+
+/******************************************************************************/
+/* Generated definitions                                                      */
+/******************************************************************************/
+// Identifiers: M_BALL, M_BOUNCE...
+#define PROTO_ID(name, ident, fields)		name = ident,
+enum { PROTO_MESSAGES(PROTO_ID) };
+
+// Dispatch table indexes: PROTO_IDX_M_BALL... and PROTO_COUNT
+#define PROTO_IDX(name, ident, fields)		PROTO_IDX_##name,
+enum { PROTO_MESSAGES(PROTO_IDX) PROTO_COUNT };
+
+// Word position of every field (M_BALL_x_W...) and payload size (M_BALL_WORDS...)
+#define PROTO_FIELD_W(m, type, f)			m##_##f##_W,
+#define PROTO_LAYOUT(name, ident, fields) \
+	enum { fields(PROTO_FIELD_W, name) name##_WORDS }; \
+	typedef char name##_fits_in_frame[(name##_WORDS <= MAX_MSG/2) ? 1 : -1];
+PROTO_MESSAGES(PROTO_LAYOUT)
+
+// Pack: M_BALL_pack(&frame, x, y)...
+#define PROTO_PARAM(m, type, f)				, type f
+#define PROTO_STORE(m, type, f)				frame->data[m##_##f##_W] = (unsigned int)f;
+#define PROTO_PACK(name, ident, fields) \
+	static inline void name##_pack(CANFrame *frame fields(PROTO_PARAM, name)) { \
+		frame->id = name; \
+		frame->dlc = name##_WORDS*2; \
+		fields(PROTO_STORE, name) \
+	}
+PROTO_MESSAGES(PROTO_PACK)
+
+// Unpack: M_BALL_x(&frame)...
+#define PROTO_GET(m, type, f) \
+	static inline type m##_##f(const CANFrame *frame) { \
+		return (type)frame->data[m##_##f##_W]; \
+	}
+#define PROTO_UNPACK(name, ident, fields)	fields(PROTO_GET, name)
+PROTO_MESSAGES(PROTO_UNPACK)
+
+// Pack and queue for transmission: PROTO_SEND(M_BALL, x, y)
+#define PROTO_SEND(name, ...) \
+	do { CANFrame f_; name##_pack(&f_, ##__VA_ARGS__); CANSendFrame(&f_); } while (0)
+
+/******************************************************************************/
+/* Dispatch                                                                   */
+/******************************************************************************/
+// Message handler, the frame is only valid during the call
+typedef void (*ProtoHandler)(const CANFrame *frame);
+
+// Calls the table entry of the received message. Unknown messages, messages
+// without handler and frames whose length doesn't match the layout are ignored.
+// return: 1 if a handler was called
+#define PROTO_CASE(name, ident, fields) \
+	case name: \
+		if (frame->dlc == name##_WORDS*2) handler = table[PROTO_IDX_##name]; \
+		break;
+static inline unsigned char proto_dispatch(const ProtoHandler *table, const CANFrame *frame) {
+	ProtoHandler handler = 0;
+
+	switch (frame->id) {
+		PROTO_MESSAGES(PROTO_CASE)
+	}
+	if (!handler) return 0;
+	handler(frame);
+	return 1;
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <p30f4011.h>
 #include <uart.h>
+#include "glyph.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -229,6 +230,7 @@ void reset_cursor() {
 }
 
 void draw_number(unsigned int number);
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill);
 
 void draw_screen() {
 	int i, j;
@@ -308,404 +310,31 @@ void draw_screen() {
 	pre_p2y = p2y;
 }
 
+/* Draws a digit with its top left cell at the cursor
+ */
 void draw_number(unsigned int number) {
-	switch (number) {
-		// ####
-		// #  #
-		// #  #
-		// #  #
-		// ####
-		case 0:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		case 1:
-				move_right();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		// #
-		// ####
-		case 2:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		//    #
-		// ####
-		case 3:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #  #
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 4:
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
-		// ####
-		// #
-		// ####
-		//    #
-		// ####
-		case 5:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #
-		// #
-		// ####
-		// #  #
-		// ####
-		case 6:
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		//    #
-		//    #
-		//    #
-		case 7:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		// #  #
-		// ####
-		case 8:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 9:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
+	GlyphDraw(number, cx, cy, draw_span);
+}
+
+/* Draws a run of a digit, the background runs are skipped
+ */
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill) {
+	unsigned int i;
+	
+	if (!fill) return;
+	while (cy < y) {
+		move_down();
+	}
+	while (cy > y) {
+		move_up();
+	}
+	while (cx < x) {
+		move_right();
+	}
+	while (cx > x) {
+		move_left();
+	}
+	for (i = 0; i < len; i++) {
+		draw_fill();
 	}
 }
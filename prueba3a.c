@@ -10,6 +10,7 @@
 #include <time.h>
 #include <stdlib.h>
 #include "can.h"
+#include "proto.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -39,14 +40,6 @@ _FGS(CODE_PROT_OFF);
 #define SERV_NO		0
 #define SERV_YES	1
 
-#define	M_BALL		00
-#define	M_BOUNCE	02
-#define	M_POINT		04
-#define	S1_PADDLE	10
-#define	S1_SERVICE	11
-#define	S2_PADDLE	20
-#define	S2_SERVICE	21
-
 /******************************************************************************/
 /* Global Variable declaration                                                */
 /******************************************************************************/
@@ -101,6 +94,7 @@ void _ISR _C1Interrupt() {
 		C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
 		C1INTFbits.RX0IF = 0;
 	}
+	CANTxInterrupt();				// Refill the tx buffers already sent
 	IFS1bits.C1IF = 0;
 }
 
@@ -123,7 +117,6 @@ int main(void)
 	
 	// mode: 0->nothing, 1->bounce, 2->point
 	int mode, winner, i;
-	unsigned int ball_coordinates[2];
 	while (1) {
 		mode = 0;
 		winner = 0;
@@ -178,11 +171,9 @@ int main(void)
 		}
 		
 		// Send messages
-		if (mode == 1) CANSendMsg(M_BOUNCE, 0, NULL);
-		else if (mode == 2) CANSendMsg(M_POINT, 1, &winner);
-		ball_coordinates[0] = bx;
-		ball_coordinates[1] = by;
-		CANSendMsg(M_BALL, 2, ball_coordinates);
+		if (mode == 1) PROTO_SEND(M_BOUNCE);
+		else if (mode == 2) PROTO_SEND(M_POINT, winner);
+		PROTO_SEND(M_BALL, bx, by);
 		
 		// Wait until next update
 		for (i = 0; i < 100-20*speed; i++) Delay5ms();
@@ -218,11 +209,19 @@ void CAN_config() {
 	// Local CAN interrupts
 	C1INTEbits.RX0IE = 1; 		// Enable CAN interrupt associated to rx buffer 0
 	C1INTFbits.RX0IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 0
-	
-	/* Tx buffer 0 */
+	C1INTEbits.TX0IE = 1; 		// Enable CAN interrupts associated to tx buffers 0-2
+	C1INTEbits.TX1IE = 1;
+	C1INTEbits.TX2IE = 1;
+	C1INTFbits.TX0IF = 0; 		// Clear CAN interrupt flags associated to tx buffers 0-2
+	C1INTFbits.TX1IF = 0;
+	C1INTFbits.TX2IF = 0;
+
+	/* Tx buffers 0-2 */
 
 	// General transmission configuration
-	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flag
+	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flags
+	C1TX1CONbits.TXREQ = 0;
+	C1TX2CONbits.TXREQ = 0;
 
 	/* Rx buffer 0 */
 	
@@ -9,6 +9,9 @@
 #include <p30f4011.h>
 #include <uart.h>
 #include "can.h"
+#include "proto.h"
+#include "glyph.h"
+#include "evq.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -55,14 +58,6 @@ _FGS(CODE_PROT_OFF);
 
 #define FILL		"#"
 
-#define	M_BALL		00
-#define	M_BOUNCE	02
-#define	M_POINT		04
-#define	S1_PADDLE	10
-#define	S1_SERVICE	11
-#define	S2_PADDLE	20
-#define	S2_SERVICE	21
-
 /******************************************************************************/
 /* Global Variable declaration                                                */
 /******************************************************************************/
@@ -74,6 +69,8 @@ volatile unsigned int p1x, p1y, p2x, p2y;
 volatile unsigned int score[2];
 // Previous versions of ball and paddle variables
 volatile unsigned int pre_bx, pre_by, pre_p1y, pre_p2y;
+// Sequence number of the last paddle 1 and 2 positions sent
+unsigned int p1_seq, p2_seq;
 // Current screen cursor position (Range: 0-WIDTH, 0-LENGTH)
 unsigned int cx, cy;
 
@@ -85,13 +82,13 @@ void _ISR _U1RXInterrupt() {
 	//WriteUART1(c);
 	//while (BusyUART1());
 	
-	if (c == UP1) if (p1y > 0) {pre_p1y = p1y; p1y -= 1; CANSendMsg(S1_PADDLE, 1, &p1y);}
-	if (c == DOWN1) if (p1y < LENGTH-PADDLE_L) {pre_p1y = p1y; p1y += 1; CANSendMsg(S1_PADDLE, 1, &p1y);}
-	if (c == SERVICE1) CANSendMsg(S1_SERVICE, 0, 0);
+	if (c == UP1) if (p1y > 0) {pre_p1y = p1y; p1y -= 1; PROTO_SEND(S1_PADDLE, p1y, ++p1_seq);}
+	if (c == DOWN1) if (p1y < LENGTH-PADDLE_L) {pre_p1y = p1y; p1y += 1; PROTO_SEND(S1_PADDLE, p1y, ++p1_seq);}
+	if (c == SERVICE1) EvqPost(EV_SERVE, 1);
 
-	if (c == UP2) if (p2y > 0) {pre_p2y = p2y; p2y -= 1; CANSendMsg(S2_PADDLE, 1, &p2y);}
-	if (c == DOWN2) if (p2y < LENGTH-PADDLE_L) {pre_p2y = p2y; p2y += 1; CANSendMsg(S2_PADDLE, 1, &p2y);}
-	if (c == SERVICE2) CANSendMsg(S2_SERVICE, 0, 0);
+	if (c == UP2) if (p2y > 0) {pre_p2y = p2y; p2y -= 1; PROTO_SEND(S2_PADDLE, p2y, ++p2_seq);}
+	if (c == DOWN2) if (p2y < LENGTH-PADDLE_L) {pre_p2y = p2y; p2y += 1; PROTO_SEND(S2_PADDLE, p2y, ++p2_seq);}
+	if (c == SERVICE2) EvqPost(EV_SERVE, 2);
 	
 	IFS0bits.U1RXIF = 0;
 }
@@ -108,18 +105,18 @@ void _ISR _C1Interrupt() {
 				by = C1RX0B2;
 				break;
 			case M_BOUNCE:
-				WriteUART1(7);			// Send the buzzer character back to the UART
-				while (BusyUART1());	// Wait until the character is transmitted
+				EvqPost(EV_BOUNCE, 0);	// The main loop sends the buzzer character
 				break;
 			case M_POINT:
 				winner = C1RX0B1;
-				score[winner-1] = (score[winner-1] + 1) % 10;
+				EvqPost(EV_POINT, winner);
 				break;
 		}
 
 		C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
 		C1INTFbits.RX0IF = 0;
 	}
+	CANTxInterrupt();				// Refill the tx buffers already sent
 	IFS1bits.C1IF = 0;
 }
 
@@ -131,6 +128,7 @@ void CAN_config();
 void slave_init();
 void clear_screen();
 void draw_screen();
+void process_events();
 
 int main(void){
 	UARTConfig();
@@ -143,6 +141,7 @@ int main(void){
 	clear_screen();
 	draw_screen();
 	while (1) {
+		process_events();
 		if (pre_bx != bx || pre_by != by || pre_p1y != p1y || pre_p2y != p2y) {
 			draw_screen();
 			//CANSendMsg(S1_PADDLE, 1, &p1y);
@@ -151,6 +150,30 @@ int main(void){
 	}
 	
 	return 0;
+}
+
+/* Handles the events posted by the interrupts since the last call, so the UART
+ * output they need doesn't wait inside an interrupt
+ */
+void process_events() {
+	Event event;
+	
+	while (EvqGet(&event)) {
+		switch (event.type) {
+			case EV_BOUNCE:
+				WriteUART1(7);			// Send the buzzer character back to the UART
+				while (BusyUART1());	// Wait until the character is transmitted
+				break;
+			case EV_POINT:
+				score[event.arg-1] = (score[event.arg-1] + 1) % 10;
+				draw_screen();
+				break;
+			case EV_SERVE:
+				if (event.arg == 1) PROTO_SEND(S1_SERVICE);
+				else PROTO_SEND(S2_SERVICE);
+				break;
+		}
+	}
 }
 
 void UARTConfig(){
@@ -200,11 +223,19 @@ void CAN_config() {
 	// Local CAN interrupts
 	C1INTEbits.RX0IE = 1; 		// Enable CAN interrupt associated to rx buffer 0
 	C1INTFbits.RX0IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 0
-	
-	/* Tx buffer 0 */
+	C1INTEbits.TX0IE = 1; 		// Enable CAN interrupts associated to tx buffers 0-2
+	C1INTEbits.TX1IE = 1;
+	C1INTEbits.TX2IE = 1;
+	C1INTFbits.TX0IF = 0; 		// Clear CAN interrupt flags associated to tx buffers 0-2
+	C1INTFbits.TX1IF = 0;
+	C1INTFbits.TX2IF = 0;
+
+	/* Tx buffers 0-2 */
 
 	// General transmission configuration
-	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flag
+	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flags
+	C1TX1CONbits.TXREQ = 0;
+	C1TX2CONbits.TXREQ = 0;
 
 	/* Rx buffer 0 */
 	
@@ -321,6 +352,7 @@ void reset_cursor() {
 }
 
 void draw_number(unsigned int number);
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill);
 
 void draw_screen() {
 	int i, j;
@@ -400,404 +432,31 @@ void draw_screen() {
 	pre_p2y = p2y;
 }
 
+/* Draws a digit with its top left cell at the cursor
+ */
 void draw_number(unsigned int number) {
-	switch (number) {
-		// ####
-		// #  #
-		// #  #
-		// #  #
-		// ####
-		case 0:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		case 1:
-				move_right();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		// #
-		// ####
-		case 2:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		//    #
-		// ####
-		case 3:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #  #
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 4:
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
-		// ####
-		// #
-		// ####
-		//    #
-		// ####
-		case 5:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #
-		// #
-		// ####
-		// #  #
-		// ####
-		case 6:
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		//    #
-		//    #
-		//    #
-		case 7:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		// #  #
-		// ####
-		case 8:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 9:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
+	GlyphDraw(number, cx, cy, draw_span);
+}
+
+/* Draws a run of a digit, the background runs are skipped
+ */
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill) {
+	unsigned int i;
+	
+	if (!fill) return;
+	while (cy < y) {
+		move_down();
+	}
+	while (cy > y) {
+		move_up();
+	}
+	while (cx < x) {
+		move_right();
+	}
+	while (cx > x) {
+		move_left();
+	}
+	for (i = 0; i < len; i++) {
+		draw_fill();
 	}
 }
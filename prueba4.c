@@ -8,6 +8,9 @@
 
 #include <p30f4011.h>
 #include <uart.h>
+#include "can.h"
+#include "proto.h"
+#include "glyph.h"
 
 /******************************************************************************/
 /* Configuration words                                                        */
@@ -51,14 +54,6 @@ _FGS(CODE_PROT_OFF);
 
 #define FILL		"#"
 
-#define	M_BALL		00
-#define	M_BOUNCE	02
-#define	M_POINT		04
-#define	S1_PADDLE	10
-#define	S1_SERVICE	11
-#define	S2_PADDLE	20
-#define	S2_SERVICE	21
-
 /******************************************************************************/
 /* Global Variable declaration                                                */
 /******************************************************************************/
@@ -70,6 +65,8 @@ unsigned int p1x, p1y, p2x, p2y;
 unsigned int score[2];
 // Previous versions of ball and paddle variables
 unsigned int pre_bx, pre_by, pre_p1y, pre_p2y;
+// Sequence number of the last paddle position sent
+unsigned int p1_seq;
 // Current screen cursor position (Range: 0-WIDTH, 0-LENGTH)
 unsigned int cx, cy;
 
@@ -90,7 +87,7 @@ void _ISR _U1RXInterrupt() {
 		pre_p1y = p1y; p1y -= 1; 
 		//WriteUART1(105);
 		//while (BusyUART1());
-		CANSendMsg(S1_PADDLE, 1, &p1y);
+		PROTO_SEND(S1_PADDLE, p1y, ++p1_seq);
 		//WriteUART1(105);
 		//while (BusyUART1());
 	}
@@ -98,7 +95,7 @@ void _ISR _U1RXInterrupt() {
 		pre_p1y = p1y; p1y += 1;
 		//WriteUART1(105);
 		//while (BusyUART1());
-		CANSendMsg(S1_PADDLE, 1, &p1y);
+		PROTO_SEND(S1_PADDLE, p1y, ++p1_seq);
 		//WriteUART1(105);
 		//while (BusyUART1());
 	}
@@ -125,6 +122,7 @@ void _ISR _C1Interrupt() {
 		C1RX0CONbits.RXFUL = 0; 	// Clear reception full status flag
 		C1INTFbits.RX0IF = 0;
 	}
+	CANTxInterrupt();				// Refill the tx buffers already sent
 	IFS1bits.C1IF = 0;
 }
 
@@ -202,11 +200,19 @@ void CAN_config() {
 	// Local CAN interrupts
 	C1INTEbits.RX0IE = 1; 		// Enable CAN interrupt associated to rx buffer 0
 	C1INTFbits.RX0IF = 0; 		// Clear CAN interrupt flag associated to rx buffer 0
-	
-	/* Tx buffer 0 */
+	C1INTEbits.TX0IE = 1; 		// Enable CAN interrupts associated to tx buffers 0-2
+	C1INTEbits.TX1IE = 1;
+	C1INTEbits.TX2IE = 1;
+	C1INTFbits.TX0IF = 0; 		// Clear CAN interrupt flags associated to tx buffers 0-2
+	C1INTFbits.TX1IF = 0;
+	C1INTFbits.TX2IF = 0;
+
+	/* Tx buffers 0-2 */
 
 	// General transmission configuration
-	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flag
+	C1TX0CONbits.TXREQ = 0; 	// Clear transmission request flags
+	C1TX1CONbits.TXREQ = 0;
+	C1TX2CONbits.TXREQ = 0;
 
 	/* Rx buffer 0 */
 	
@@ -323,6 +329,7 @@ void reset_cursor() {
 }
 
 void draw_number(unsigned int number);
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill);
 
 void draw_screen() {
 	int i, j;
@@ -402,404 +409,31 @@ void draw_screen() {
 	pre_p2y = p2y;
 }
 
+/* Draws a digit with its top left cell at the cursor
+ */
 void draw_number(unsigned int number) {
-	switch (number) {
-		// ####
-		// #  #
-		// #  #
-		// #  #
-		// ####
-		case 0:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		//  ##
-		case 1:
-				move_right();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		// #
-		// ####
-		case 2:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		// ####
-		//    #
-		// ####
-		case 3:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #  #
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 4:
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
-		// ####
-		// #
-		// ####
-		//    #
-		// ####
-		case 5:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// #
-		// #
-		// ####
-		// #  #
-		// ####
-		case 6:
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		//    #
-		//    #
-		//    #
-		//    #
-		case 7:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-			
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		// #  #
-		// ####
-		case 8:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			break;
-		// ####
-		// #  #
-		// ####
-		//    #
-		//    #
-		case 9:
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-				move_right();
-				move_right();
-			draw_fill();
-				move_down();
-				move_left();
-				move_left();
-				move_left();
-				move_left();
-				
-			draw_fill();
-			draw_fill();
-			draw_fill();
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-				move_down();
-				move_left();
-				
-			draw_fill();
-			break;
+	GlyphDraw(number, cx, cy, draw_span);
+}
+
+/* Draws a run of a digit, the background runs are skipped
+ */
+void draw_span(unsigned int x, unsigned int y, unsigned int len, unsigned char fill) {
+	unsigned int i;
+	
+	if (!fill) return;
+	while (cy < y) {
+		move_down();
+	}
+	while (cy > y) {
+		move_up();
+	}
+	while (cx < x) {
+		move_right();
+	}
+	while (cx > x) {
+		move_left();
+	}
+	for (i = 0; i < len; i++) {
+		draw_fill();
 	}
 }
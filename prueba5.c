@@ -0,0 +1,132 @@
+/******************************************************************************/
+/*                                                                            */
+/*  Description: Property test of physics.c, run on the host PC:             */
+/*               gcc -o prueba5 prueba5.c physics.c && ./prueba5 [n] [seed]   */
+/*                                                                            */
+/*  Author:                                                                   */
+/*                                                                            */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "physics.h"
+
+/******************************************************************************/
+/* Constants				                                                  */
+/******************************************************************************/
+#define TRIALS		2000000UL	// Default number of random trajectories
+#define MAX_STEP	4			// Maximum slow velocity, fixed point per tick
+#define MAX_SPLIT	256			// Maximum number of slow moves per fast move
+
+/******************************************************************************/
+/* Global Variable declaration                                                */
+/******************************************************************************/
+unsigned long rng_state;
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+unsigned long rng();
+int rng_range(int lo, int hi);
+int check_trial(unsigned long trial);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+/* Fires random trajectories at PhysMove and checks that a fast move gives
+ * exactly the same result as the same path done in slow moves shorter than a
+ * few fixed point units, which can't skip a wall or a paddle face.
+ */
+int main(int argc, char *argv[]) {
+	unsigned long trials = (argc > 1) ? strtoul(argv[1], NULL, 0) : TRIALS;
+	unsigned long trial, failed = 0;
+	
+	rng_state = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+	if (rng_state == 0) rng_state = 1;
+	
+	for (trial = 0; trial < trials; trial++) {
+		if (!check_trial(trial)) failed++;
+		if (failed >= 10) break;
+	}
+	
+	printf("%lu trials, %lu failed\n", trial, failed);
+	return failed ? 1 : 0;
+}
+
+/* xorshift32 pseudo-random generator
+ */
+unsigned long rng() {
+	rng_state ^= (rng_state << 13) & 0xFFFFFFFFUL;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= (rng_state << 5) & 0xFFFFFFFFUL;
+	return rng_state;
+}
+
+/* return: random number in [lo, hi]
+ */
+int rng_range(int lo, int hi) {
+	return lo + (int)(rng() % (unsigned long)(hi - lo + 1));
+}
+
+/* Checks one random trajectory
+ * return: 1, if every property holds
+ * 		   0, otherwise
+ */
+int check_trial(unsigned long trial) {
+	PhysBall start, fast, slow;
+	unsigned int p1y, p2y, split, i;
+	unsigned char fast_events, slow_events = 0, events, flip = 0;
+	int hit_y, ok = 1;
+	
+	// Ball anywhere between the paddle faces, paddles anywhere
+	start.x = rng_range(TO_FIX(PAD1_X + PADDLE_W), TO_FIX(PAD2_X));
+	start.y = rng_range(0, TO_FIX(LENGTH));
+	start.vx = rng_range(-MAX_STEP, MAX_STEP);
+	start.vy = rng_range(-MAX_STEP, MAX_STEP);
+	p1y = rng_range(0, LENGTH - PADDLE_L);
+	p2y = rng_range(0, LENGTH - PADDLE_L);
+	split = rng_range(1, MAX_SPLIT);
+	
+	// Fast: the whole path in one tick, or in 'split' ticks of one call
+	fast = start;
+	if (rng() & 1) {
+		fast.vx *= split;
+		fast.vy *= split;
+		fast_events = PhysMove(&fast, p1y, p2y, 1, &hit_y);
+		fast.vx /= (int)split;
+		fast.vy /= (int)split;
+	} else {
+		fast_events = PhysMove(&fast, p1y, p2y, split, &hit_y);
+	}
+	
+	// Slow: one call per tick, too short for two wall bounces. PHYS_FLIP
+	// follows the wall bounces after the last paddle contact of all the calls.
+	slow = start;
+	for (i = 0; i < split; i++) {
+		events = PhysMove(&slow, p1y, p2y, 1, &hit_y);
+		if (events & (PHYS_PADDLE1 | PHYS_PADDLE2)) flip = events & PHYS_FLIP;
+		else if (events & PHYS_WALL) flip ^= PHYS_FLIP;
+		slow_events |= events & ~PHYS_FLIP;
+	}
+	if (slow_events & (PHYS_PADDLE1 | PHYS_PADDLE2)) slow_events |= flip;
+	
+	if (fast.x != slow.x || fast.y != slow.y || fast.vx != slow.vx || fast.vy != slow.vy ||
+		fast_events != slow_events) {
+		ok = 0;
+	}
+	// The ball keeps its speed and stays between the walls
+	if (abs(fast.vx) != abs(start.vx) || abs(fast.vy) != abs(start.vy) ||
+		fast.y < 0 || fast.y > TO_FIX(LENGTH)) {
+		ok = 0;
+	}
+	
+	if (!ok) {
+		printf("trial %lu: ball (%d, %d) v (%d, %d) x%u, paddles %u %u\n", trial,
+			   start.x, start.y, start.vx, start.vy, split, p1y, p2y);
+		printf("  fast (%d, %d) v (%d, %d) events %02X\n",
+			   fast.x, fast.y, fast.vx, fast.vy, fast_events);
+		printf("  slow (%d, %d) v (%d, %d) events %02X\n",
+			   slow.x, slow.y, slow.vx, slow.vy, slow_events);
+	}
+	return ok;
+}
@@ -0,0 +1,132 @@
+/******************************************************************************/
+/*                                                                            */
+/*  Description: Torn frame stress test of seqlock.h, run on the host PC:    */
+/*               gcc -O2 -o prueba6 prueba6.c && ./prueba6 [seconds]          */
+/*                                                                            */
+/*  Author:                                                                   */
+/*                                                                            */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#include "seqlock.h"
+
+/******************************************************************************/
+/* Constants				                                                  */
+/******************************************************************************/
+#define SECONDS		2			// Default test length
+#define PERIOD_US	20			// Period of the interrupt that publishes states
+#define FIELDS		12			// Words of the state, about the slaves' GameState
+
+/******************************************************************************/
+/* Global Variable declaration                                                */
+/******************************************************************************/
+// State published by the interrupt: every field is derived from the same count
+typedef struct {
+	unsigned int field[FIELDS];
+} State;
+State state;
+SeqCount state_seq;
+volatile unsigned int published;
+
+/******************************************************************************/
+/* Interrupts                                                                 */
+/******************************************************************************/
+/* Plays the CAN interrupt of a slave: publishes the next state
+ */
+void timer_interrupt(int sig) {
+	unsigned int i, n = published + 1;
+
+	SeqWriteBegin(&state_seq);
+	for (i = 0; i < FIELDS; i++) state.field[i] = n*(i+1);
+	SeqWriteEnd(&state_seq);
+	published = n;
+}
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+void read_state(State *copy, unsigned long *retries);
+void read_plain(State *copy);
+int torn(const State *copy);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+/* Reads the state as fast as possible while the timer interrupt publishes new
+ * ones, with the seqlock and without it. The copies without it must show torn
+ * states, or the test didn't interrupt any copy, and the ones with it never.
+ */
+int main(int argc, char *argv[]) {
+	unsigned long seconds = (argc > 1) ? strtoul(argv[1], NULL, 0) : SECONDS;
+	unsigned long reads = 0, retries = 0, torn_seq = 0, torn_plain = 0;
+	struct itimerval timer = {{0, PERIOD_US}, {0, PERIOD_US}};
+	struct sigaction action = {0};
+	State copy;
+	time_t end;
+
+	action.sa_handler = timer_interrupt;
+	sigaction(SIGALRM, &action, NULL);
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	end = time(NULL) + seconds;
+	while (time(NULL) < end) {
+		read_state(&copy, &retries);
+		if (torn(&copy)) torn_seq++;
+		read_plain(&copy);
+		if (torn(&copy)) torn_plain++;
+		reads++;
+	}
+
+	timer.it_value.tv_usec = 0;
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	printf("%u states published, %lu reads\n", published, reads);
+	printf("seqlock: %lu torn, %lu retries\n", torn_seq, retries);
+	printf("plain:   %lu torn\n", torn_plain);
+	if (torn_plain == 0) {
+		printf("FAIL: no copy was interrupted, the test proves nothing\n");
+		return 1;
+	}
+	if (torn_seq > 0) {
+		printf("FAIL\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+/* Copies the state the way the slaves do
+ */
+void read_state(State *copy, unsigned long *retries) {
+	unsigned int start;
+
+	for (;;) {
+		start = SeqReadBegin(&state_seq);
+		SeqCopy(copy, &state, sizeof(state));
+		if (!SeqReadRetry(&state_seq, start)) return;
+		(*retries)++;
+	}
+}
+
+/* Copies the state a field at a time without any protection
+ */
+void read_plain(State *copy) {
+	volatile unsigned int *field = state.field;
+	unsigned int i;
+
+	for (i = 0; i < FIELDS; i++) copy->field[i] = field[i];
+}
+
+/* Returns 1 if the fields of a copy come from different states
+ */
+int torn(const State *copy) {
+	unsigned int i;
+
+	for (i = 1; i < FIELDS; i++)
+		if (copy->field[i] != copy->field[0]*(i+1)) return 1;
+	return 0;
+}
@@ -0,0 +1,129 @@
+/* screen.c - Implementación de las funciones de screen.h. */
+#include "screen.h"
+
+#define NO_SPRITE		0xFFFF
+
+// Cells, 2 bits each, and cells changed since they were sent, 1 bit each
+static unsigned char cells[SCREEN_ROWS][SCREEN_COLS/4];
+static unsigned char dirty[SCREEN_ROWS][SCREEN_COLS/8];
+static unsigned int dirty_count;
+// Cell shown over the screen
+static unsigned int sprite_x = NO_SPRITE, sprite_y;
+static unsigned char sprite_cell;
+// Characters of the cell values
+static char cell_chars[4];
+// The terminal must be cleared before sending the cells
+static unsigned char clear_pending;
+
+static unsigned char get(unsigned int x, unsigned int y) {
+	return (cells[y][x >> 2] >> ((x & 3) * 2)) & 3;
+}
+
+static void mark(unsigned int x, unsigned int y) {
+	unsigned char bit = 1 << (x & 7);
+
+	if (!(dirty[y][x >> 3] & bit)) {
+		dirty[y][x >> 3] |= bit;
+		dirty_count++;
+	}
+}
+
+/* Character of a cell as it must look on the terminal
+ */
+static char shown(unsigned int x, unsigned int y) {
+	if (x == sprite_x && y == sprite_y) return cell_chars[sprite_cell];
+	return cell_chars[get(x, y)];
+}
+
+/* Characters already on the terminal, for the cursor to move by writing them again
+ */
+static unsigned char reader(unsigned int x, unsigned int y) {
+	if (x >= SCREEN_COLS || y >= SCREEN_ROWS || clear_pending) return 0;
+	if (dirty[y][x >> 3] & (1 << (x & 7))) return 0;
+	return shown(x, y);
+}
+
+void ScreenInit(const char *chars) {
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) cell_chars[i] = chars[i];
+	ScreenClear();
+}
+
+void ScreenClear() {
+	unsigned int x, y;
+
+	for (y = 0; y < SCREEN_ROWS; y++) {
+		for (x = 0; x < SCREEN_COLS/4; x++) cells[y][x] = 0;
+		for (x = 0; x < SCREEN_COLS/8; x++) dirty[y][x] = 0;
+	}
+	dirty_count = 0;
+	clear_pending = 1;
+	TermSetCellReader(reader);		// Back from whatever else was on the terminal
+	// The sprite must be sent again
+	if (sprite_x != NO_SPRITE) mark(sprite_x, sprite_y);
+}
+
+void ScreenSet(unsigned int x, unsigned int y, unsigned char cell) {
+	unsigned char shift;
+
+	if (x >= SCREEN_COLS || y >= SCREEN_ROWS || get(x, y) == cell) return;
+	shift = (x & 3) * 2;
+	cells[y][x >> 2] = (cells[y][x >> 2] & ~(3 << shift)) | ((cell & 3) << shift);
+	mark(x, y);
+}
+
+void ScreenFill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned char cell) {
+	unsigned int i, j;
+
+	for (i = y; i < y + h; i++) {
+		for (j = x; j < x + w; j++) ScreenSet(j, i, cell);
+	}
+}
+
+unsigned char ScreenGet(unsigned int x, unsigned int y) {
+	if (x >= SCREEN_COLS || y >= SCREEN_ROWS) return SCREEN_BLANK;
+	return get(x, y);
+}
+
+void ScreenSprite(unsigned int x, unsigned int y, unsigned char cell) {
+	if (x == sprite_x && y == sprite_y && cell == sprite_cell) return;
+	if (sprite_x != NO_SPRITE) mark(sprite_x, sprite_y);
+	if (x < SCREEN_COLS && y < SCREEN_ROWS) {
+		sprite_x = x;
+		sprite_y = y;
+		sprite_cell = cell;
+		mark(x, y);
+	} else {
+		sprite_x = NO_SPRITE;
+	}
+}
+
+void ScreenFlush(unsigned int budget) {
+	unsigned long start = TermBytes();
+	unsigned int x, y, b;
+	unsigned char bits;
+
+	if (clear_pending) {
+		TermClear();
+		clear_pending = 0;
+	}
+	for (y = 0; y < SCREEN_ROWS && dirty_count > 0; y++) {
+		for (b = 0; b < SCREEN_COLS/8; b++) {
+			bits = dirty[y][b];
+			for (x = b*8; bits; x++, bits >>= 1) {
+				if (!(bits & 1)) continue;
+				if (TermBytes() - start >= budget) return;
+				// Clean before writing, so the cursor may pass over it again
+				dirty[y][b] &= ~(1 << (x & 7));
+				dirty_count--;
+				TermGoto(x, y);
+				TermPutc(shown(x, y));
+			}
+		}
+	}
+}
+
+unsigned int ScreenDirty() {
+	return dirty_count;
+}
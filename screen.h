@@ -0,0 +1,39 @@
+/* screen.h - Copia en memoria de la pantalla del terminal. */
+#ifndef SCREEN_H
+#define SCREEN_H
+#include "term.h"
+
+// Screen size
+#define SCREEN_COLS		TERM_COLS
+#define SCREEN_ROWS		TERM_ROWS
+
+// Cell values, shown with the characters given to ScreenInit
+#define SCREEN_BLANK	0
+#define SCREEN_FILL		1
+#define SCREEN_BALL		2
+#define SCREEN_OTHER	3
+
+// Flush budget that sends every changed cell
+#define SCREEN_NO_LIMIT	0xFFFF
+
+// Set the characters of the 4 cell values and start with a blank screen
+void ScreenInit(const char *chars);
+// Blank every cell, the terminal is cleared on the next flush. Also tells
+// term.c about the cells again, after anything else written on the terminal
+// dropped the cell reader.
+void ScreenClear(void);
+// Change cells. Only cells that change are sent by the next flush.
+// Coordinates outside the screen are ignored.
+void ScreenSet(unsigned int x, unsigned int y, unsigned char cell);
+void ScreenFill(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned char cell);
+unsigned char ScreenGet(unsigned int x, unsigned int y);
+// Show one cell over the screen at x, y without changing what is below it
+void ScreenSprite(unsigned int x, unsigned int y, unsigned char cell);
+// Send the changed cells to the terminal, row by row. Stops once 'budget' bytes
+// were sent (it may go over by one cell), the rest are sent by the next flush.
+void ScreenFlush(unsigned int budget);
+
+// Statistics
+unsigned int ScreenDirty(void);		// Cells waiting for the next flush
+
+#endif
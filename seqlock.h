@@ -0,0 +1,57 @@
+/* seqlock.h - Estados publicados por las interrupciones y leídos sin cortes. */
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+// Sequence counter of a shared state, odd while the writer is changing it
+typedef volatile unsigned int SeqCount;
+
+// Keeps the compiler from moving memory accesses across it
+#define SEQ_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
+// The simulator serves there the interrupts that land in the middle of a copy
+#ifndef SIM_PREEMPT
+#define SIM_PREEMPT()
+#endif
+
+// Writer side. There must be one writer, or writers that can't preempt each
+// other: interrupts at the same priority, or the main loop with the interrupts
+// that write disabled.
+static inline void SeqWriteBegin(SeqCount *seq) {
+	(*seq)++;
+	SEQ_BARRIER();
+}
+
+static inline void SeqWriteEnd(SeqCount *seq) {
+	SEQ_BARRIER();
+	(*seq)++;
+}
+
+// Reader side: copy the state after SeqReadBegin and copy it again while
+// SeqReadRetry is true. The reader must never preempt the writer.
+static inline unsigned int SeqReadBegin(SeqCount *seq) {
+	unsigned int start;
+
+	while ((start = *seq) & 1);
+	SEQ_BARRIER();
+	return start;
+}
+
+static inline unsigned char SeqReadRetry(SeqCount *seq, unsigned int start) {
+	SEQ_BARRIER();
+	return *seq != start;
+}
+
+// Copy a state a word at a time, as the CPU does: an interrupt can land between
+// any two words. bytes must be a whole number of words.
+static inline void SeqCopy(void *copy, const void *state, unsigned int bytes) {
+	unsigned int *to = copy;
+	const volatile unsigned int *from = state;
+	unsigned int i;
+
+	for (i = 0; i < bytes / sizeof(unsigned int); i++) {
+		to[i] = from[i];
+		SIM_PREEMPT();
+	}
+}
+
+#endif
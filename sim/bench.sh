@@ -0,0 +1,93 @@
+#!/bin/sh
+# bench.sh - La misma partida en el bus virtual con el firmware de otras revisiones.
+# Builds the nodes of every git revision given ("." for the working tree)
+# against the simulator of this tree, runs the three of them on a virtual bus
+# with the same script of keys on both slaves (serve, paddle up and down) and
+# prints the interrupt statistics of every node (SIM_STATS) and of the bus, so
+# a change can be measured against the firmware before it:
+#
+#   ./bench.sh [-s seconds] [-a adc] [-D define]... rev...
+#
+# The master runs with the real Delay5ms() the early revisions pace it with,
+# the slaves without their start-up delay. -D adds a define to the build of
+# the nodes (PROFILE, TRACE...). The handler times are host time in cycles of
+# SIM_FCY, see sim.c.
+
+secs=6
+adc=512
+defs=
+while getopts s:a:D: opt; do
+	case $opt in
+		s) secs=$OPTARG ;;
+		a) adc=$OPTARG ;;
+		D) defs="$defs -D$OPTARG" ;;
+		*) echo "usage: $0 [-s seconds] [-a adc] [-D define]... rev..." >&2; exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+sim=$(cd "$(dirname "$0")" && pwd)
+top=$(cd "$sim/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Paddle keys twice a second, a serve request every round
+keys() {
+	sleep 0.5
+	i=0
+	while [ $i -lt $((secs * 2)) ]; do
+		printf "j$1"
+		sleep 0.5
+		i=$((i + 1))
+	done
+}
+
+for rev in "$@"; do
+	dir=$work/tree
+	rm -rf "$dir"
+	mkdir -p "$dir"
+	if [ "$rev" = . ]; then
+		cp "$top"/*.c "$top"/*.h "$dir"
+	else
+		git -C "$top" archive "$rev" | tar -x -C "$dir" || exit 1
+	fi
+	rm -rf "$dir/sim"
+	mkdir "$dir/sim"
+	cp "$sim"/*.c "$sim"/*.h "$dir/sim"
+	cd "$dir/sim" || exit 1
+
+	# The modules the revision has
+	lib=
+	for module in can term uarttx screen glyph evq physics cycles lat trace prof stats; do
+		if [ -f ../$module.c ]; then lib="$lib ../$module.c"; fi
+	done
+	for node in maestro esclavo1c esclavo2c; do
+		gcc -std=gnu99 -O2 -w -I. -I.. $defs -o $node ../$node.c $lib \
+			sim.c canbus.c capture.c replay.c || exit 1
+	done
+	gcc -std=gnu99 -O2 -w -o canbusd canbusd.c capture.c || exit 1
+
+	./canbusd -p bus.sock 2> canbusd.out &
+	bus=$!
+	sleep 0.2
+	SIM_CAN=bus.sock SIM_STATS=1 SIM_ADC=$adc timeout $secs ./maestro < /dev/null > /dev/null 2> maestro.err &
+	nodes=$!
+	mkfifo keys1 keys2
+	for node in 1 2; do
+		SIM_CAN=bus.sock SIM_STATS=1 SIM_NO_DELAY=1 timeout $secs ./esclavo${node}c < keys$node > /dev/null 2> esclavo${node}c.err &
+		nodes="$nodes $!"
+	done
+	keys iiiiikkkkk > keys1 &
+	keys kkkkkiiiii > keys2 &
+	wait $nodes
+	kill $bus
+	wait $bus
+
+	echo "== $rev"
+	for node in maestro esclavo1c esclavo2c; do
+		grep "^sim: " $node.err | sed "s/^sim:/$node:/"
+	done
+	grep "^canbusd: .* frames" canbusd.out
+	echo
+	cd "$top" || exit 1
+done
@@ -0,0 +1,84 @@
+/* canbus.c - Conexión de un nodo simulado al bus CAN virtual de canbusd. */
+/* With SIM_CAN set (to the socket path, or empty for CANBUS_PATH) the node
+ * joins the bus before main(). Its frames are arbitrated and timed by the bus
+ * process, which acknowledges them or ends them with an error frame, and it
+ * receives the frames of the other nodes through its acceptance filters.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "canbus.h"
+#include "sim.h"
+
+static int bus = -1;
+static uint32_t bus_bit;			// Bit time last told to the bus
+
+static void bus_send(const SimCanFrame *frame) {
+	CanBusMsg msg;
+	unsigned int i;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = CANBUS_TX;
+	msg.id = frame->id;
+	msg.dlc = frame->dlc;
+	for (i = 0; i < 4; i++) msg.data[i] = frame->data[i];
+	msg.bit_ps = SimCanBitTime();
+	send(bus, &msg, sizeof(msg), 0);
+}
+
+static void bus_poll() {
+	CanBusMsg msg;
+	SimCanFrame frame;
+	unsigned int i;
+
+	// Joining, or a new bit time after a configuration
+	if (bus_bit != SimCanBitTime()) {
+		memset(&msg, 0, sizeof(msg));
+		msg.type = CANBUS_HELLO;
+		msg.bit_ps = bus_bit = SimCanBitTime();
+		send(bus, &msg, sizeof(msg), 0);
+	}
+
+	// One received frame per tick at most: frames that queued up while the node
+	// was not running came a frame time apart on the bus, with the interrupt
+	// of the node in between
+	while (recv(bus, &msg, sizeof(msg), MSG_DONTWAIT) == sizeof(msg)) {
+		switch (msg.type) {
+			case CANBUS_ACK:
+				SimCanTxDone(1);
+				break;
+			case CANBUS_ERROR:
+				SimCanTxDone(0);
+				break;
+			case CANBUS_RX:
+				frame.id = msg.id;
+				frame.dlc = msg.dlc;
+				for (i = 0; i < 4; i++) frame.data[i] = msg.data[i];
+				SimCanDeliver(&frame);
+				return;
+		}
+	}
+}
+
+static const SimCanBus socket_bus = {bus_send, bus_poll};
+
+__attribute__((constructor)) static void bus_start() {
+	const char *path = getenv("SIM_CAN");
+	struct sockaddr_un addr;
+
+	if (!path) return;
+	if (!*path) path = CANBUS_PATH;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	bus = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (bus < 0 || connect(bus, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror(path);
+		exit(1);
+	}
+	SimCanAttach(&socket_bus);
+}
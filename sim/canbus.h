@@ -0,0 +1,27 @@
+/* canbus.h - Mensajes entre los nodos simulados y el bus CAN virtual de canbusd. */
+#ifndef CANBUS_H
+#define CANBUS_H
+
+#include <stdint.h>
+
+// Socket of the bus, unless SIM_CAN names another one
+#define CANBUS_PATH		"/tmp/canbus.sock"
+
+// Node to bus
+#define CANBUS_HELLO	1			// Node in normal mode, at bit time bit_ps
+#define CANBUS_TX		2			// Node starts transmitting the frame
+// Bus to node
+#define CANBUS_ACK		3			// Frame transmitted and acknowledged
+#define CANBUS_ERROR	4			// Frame ended by an error frame
+#define CANBUS_RX		5			// Frame of another node
+
+// One message per datagram (SOCK_SEQPACKET)
+typedef struct {
+	uint8_t type;
+	uint8_t dlc;
+	uint16_t id;
+	uint16_t data[4];
+	uint32_t bit_ps;				// HELLO and TX: bit time of the node
+} CanBusMsg;
+
+#endif
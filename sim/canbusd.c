@@ -0,0 +1,385 @@
+/* canbusd.c - Bus CAN virtual para los nodos simulados en procesos separados. */
+/* Every node built with canbus.c and run with SIM_CAN joins the bus through a
+ * UNIX socket. The bus plays the wire in real time: among the frames waiting
+ * to be sent the lowest identifier wins the arbitration, a frame holds the bus
+ * for its bits (stuff bits and CRC included) at the bus bit time, and it ends
+ * with an ACK if another node in sync received it, or with an error frame after
+ * which its node sends it again. A node configured at another bit time is out
+ * of sync: it doesn't acknowledge nor receive, and its frames end in errors.
+ *
+ *   canbusd [-p socket] [-b bitrate] [-w capture]
+ *
+ * Without -b the bus runs at the bit time of the first node that joins. With
+ * -w every frame on the bus is recorded in a capture (capture.h) as it ends.
+ * The statistics (frames, errors, bus load, queueing and latency by
+ * identifier) are printed to stderr on SIGUSR1 and on exit.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "canbus.h"
+#include "capture.h"
+
+/******************************************************************************/
+/* Constants                                                                  */
+/******************************************************************************/
+#define MAX_NODES		8
+#define IDS				2048		// Standard identifiers
+#define SYNC_PPM		10000		// Bit time tolerance of a node in sync (1%)
+#define ERROR_BITS		17			// Error flag, delimiter and intermission
+#define TAIL_BITS		13			// CRC delimiter, ACK, ACK delimiter, EOF, intermission
+
+/******************************************************************************/
+/* Global Variable declaration                                                */
+/******************************************************************************/
+typedef struct {
+	int fd;							// -1 if the slot is free
+	uint32_t bit_ps;				// 0 until the node says hello
+	unsigned char pending;			// Frame waiting for the bus
+	unsigned char retry;			// Sending it again after an error
+	CanBusMsg frame;
+	unsigned long long requested;	// When it started waiting
+} Node;
+
+typedef struct {
+	unsigned long frames, errors;
+	unsigned long long wait_total, wait_max;	// Request to start of the frame
+	unsigned long long lat_total, lat_max;		// Request to ACK
+} IdStats;
+
+Node node[MAX_NODES];
+int listener;
+const char *path = CANBUS_PATH;
+uint32_t bus_bit;					// Bit time of the bus, 0 until known
+const char *capture_path;
+void *capture;						// Opened with the first frame
+
+// Frame on the bus
+int tx = -1;
+unsigned char tx_acked;
+unsigned int tx_bits;
+unsigned long long tx_start, tx_end;
+
+// Statistics
+unsigned long long started, busy;
+unsigned long frames, errors;
+IdStats id_stats[IDS];
+volatile sig_atomic_t quit, report_now;
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+unsigned long long now_ns();
+unsigned int frame_bits(const CanBusMsg *msg, unsigned int *ack_bit);
+unsigned char in_sync(const Node *n);
+void start_frame(unsigned long long now);
+void end_frame(unsigned long long now);
+void record_frame();
+void drop_node(int n);
+void accept_node();
+void read_node(int n, unsigned long long now);
+void report();
+void on_signal(int sig);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+int main(int argc, char *argv[]) {
+	struct sockaddr_un addr;
+	struct pollfd fds[MAX_NODES + 1];
+	int index[MAX_NODES + 1];
+	struct sigaction action;
+	struct timespec timeout, *wait;
+	unsigned long long now;
+	int opt, n, count;
+
+	while ((opt = getopt(argc, argv, "p:b:w:")) != -1) {
+		switch (opt) {
+			case 'p': path = optarg; break;
+			case 'b': bus_bit = 1000000000000ULL / strtoul(optarg, NULL, 0); break;
+			case 'w': capture_path = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-p socket] [-b bitrate] [-w capture]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+	listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| listen(listener, MAX_NODES) < 0) {
+		perror(path);
+		return 1;
+	}
+	for (n = 0; n < MAX_NODES; n++) node[n].fd = -1;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_signal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGUSR1, &action, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	started = now_ns();
+	while (!quit) {
+		now = now_ns();
+		if (tx >= 0 && now >= tx_end) end_frame(now);
+		if (tx < 0) start_frame(now);
+		if (report_now) {
+			report_now = 0;
+			report();
+		}
+
+		// Sleep until a message arrives or the frame on the bus ends
+		count = 0;
+		fds[count].fd = listener;
+		fds[count].events = POLLIN;
+		index[count++] = -1;
+		for (n = 0; n < MAX_NODES; n++) {
+			if (node[n].fd < 0) continue;
+			fds[count].fd = node[n].fd;
+			fds[count].events = POLLIN;
+			index[count++] = n;
+		}
+		wait = NULL;
+		if (tx >= 0) {
+			now = now_ns();
+			now = (tx_end > now) ? tx_end - now : 0;
+			timeout.tv_sec = now / 1000000000;
+			timeout.tv_nsec = now % 1000000000;
+			wait = &timeout;
+		}
+		if (ppoll(fds, count, wait, NULL) <= 0) continue;
+
+		now = now_ns();
+		for (n = 0; n < count; n++) {
+			if (!fds[n].revents) continue;
+			if (index[n] < 0) accept_node();
+			else read_node(index[n], now);
+		}
+	}
+
+	report();
+	if (capture) CaptureClose(capture);
+	unlink(path);
+	return 0;
+}
+
+unsigned long long now_ns() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/* Bits of a standard data frame on the wire, intermission included. ack_bit
+ * receives the bits up to the ACK slot, where an unacknowledged frame ends.
+ */
+unsigned int frame_bits(const CanBusMsg *msg, unsigned int *ack_bit) {
+	unsigned char bits[128];
+	unsigned int count = 0, crc = 0, i, run, stuffed, dlc = (msg->dlc > 8) ? 8 : msg->dlc;
+	unsigned char bit, last;
+
+	// SOF, identifier, RTR, IDE, r0, DLC and data, MSB first
+	bits[count++] = 0;
+	for (i = 0; i < 11; i++) bits[count++] = (msg->id >> (10 - i)) & 1;
+	bits[count++] = 0;
+	bits[count++] = 0;
+	bits[count++] = 0;
+	for (i = 0; i < 4; i++) bits[count++] = (dlc >> (3 - i)) & 1;
+	for (i = 0; i < 8*dlc; i++)				// Byte 2k is the low byte of word k
+		bits[count++] = (msg->data[i / 16] >> (8*(i / 8 % 2) + 7 - i % 8)) & 1;
+
+	// CRC-15 (x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1)
+	for (i = 0; i < count; i++) {
+		bit = bits[i] ^ ((crc >> 14) & 1);
+		crc = (crc << 1) & 0x7FFF;
+		if (bit) crc ^= 0x4599;
+	}
+	for (i = 0; i < 15; i++) bits[count++] = (crc >> (14 - i)) & 1;
+
+	// A stuff bit after every 5 equal bits, from SOF to the end of the CRC
+	stuffed = count;
+	last = bits[0];
+	run = 1;
+	for (i = 1; i < count; i++) {
+		if (bits[i] == last) {
+			if (++run == 5) {
+				stuffed++;
+				last = !last;
+				run = 1;
+			}
+		} else {
+			last = bits[i];
+			run = 1;
+		}
+	}
+	*ack_bit = stuffed + 2;
+	return stuffed + TAIL_BITS;
+}
+
+/* A node in sync is at the bit time of the bus
+ */
+unsigned char in_sync(const Node *n) {
+	unsigned long long diff;
+
+	if (n->fd < 0 || !n->bit_ps || !bus_bit) return 0;
+	diff = (n->bit_ps > bus_bit) ? n->bit_ps - bus_bit : bus_bit - n->bit_ps;
+	return diff * 1000000 <= (unsigned long long)bus_bit * SYNC_PPM;
+}
+
+/* Arbitration: the lowest identifier waiting takes the bus
+ */
+void start_frame(unsigned long long now) {
+	unsigned int ack_bit;
+	int n;
+
+	tx = -1;
+	for (n = 0; n < MAX_NODES; n++)
+		if (node[n].fd >= 0 && node[n].pending &&
+			(tx < 0 || node[n].frame.id < node[tx].frame.id)) tx = n;
+	if (tx < 0) return;
+	if (!bus_bit) bus_bit = node[tx].frame.bit_ps;
+
+	tx_acked = 0;
+	if (in_sync(&node[tx]))
+		for (n = 0; n < MAX_NODES; n++)
+			if (n != tx && in_sync(&node[n])) tx_acked = 1;
+
+	tx_bits = frame_bits(&node[tx].frame, &ack_bit);
+	if (!tx_acked) tx_bits = ack_bit + ERROR_BITS;
+	tx_start = now;
+	tx_end = now + (unsigned long long)tx_bits * bus_bit / 1000;
+
+	if (now - node[tx].requested > id_stats[node[tx].frame.id].wait_max)
+		id_stats[node[tx].frame.id].wait_max = now - node[tx].requested;
+	id_stats[node[tx].frame.id].wait_total += now - node[tx].requested;
+}
+
+/* End of the frame on the bus: its node is told and the others receive it
+ */
+void end_frame(unsigned long long now) {
+	IdStats *s = &id_stats[node[tx].frame.id];
+	CanBusMsg msg = node[tx].frame;
+	int n;
+
+	busy += tx_end - tx_start;
+	node[tx].pending = 0;
+	node[tx].retry = !tx_acked;
+	msg.type = tx_acked ? CANBUS_ACK : CANBUS_ERROR;
+	send(node[tx].fd, &msg, sizeof(msg), MSG_DONTWAIT);
+	if (tx_acked) {
+		frames++;
+		s->frames++;
+		if (tx_end - node[tx].requested > s->lat_max) s->lat_max = tx_end - node[tx].requested;
+		s->lat_total += tx_end - node[tx].requested;
+		msg.type = CANBUS_RX;
+		for (n = 0; n < MAX_NODES; n++)
+			if (n != tx && in_sync(&node[n])) send(node[n].fd, &msg, sizeof(msg), MSG_DONTWAIT);
+	} else {
+		errors++;
+		s->errors++;
+	}
+	record_frame();
+	tx = -1;
+}
+
+/* Appends the frame that ended to the capture
+ */
+void record_frame() {
+	CaptureRecord record;
+	unsigned int i;
+
+	if (!capture_path) return;
+	if (!capture && !(capture = CaptureCreate(capture_path, bus_bit))) {
+		perror(capture_path);
+		capture_path = NULL;
+		return;
+	}
+	memset(&record, 0, sizeof(record));
+	record.time_ns = tx_end - started;
+	record.id = node[tx].frame.id;
+	record.dlc = node[tx].frame.dlc;
+	record.flags = tx_acked ? 0 : CAPTURE_ERROR;
+	for (i = 0; i < 4; i++) record.data[i] = node[tx].frame.data[i];
+	record.node = tx;
+	record.bits = tx_bits;
+	CaptureWrite(capture, &record);
+}
+
+void drop_node(int n) {
+	close(node[n].fd);
+	node[n].fd = -1;
+	node[n].pending = 0;
+	if (tx == n) tx = -1;			// The frame is cut short
+}
+
+void accept_node() {
+	int fd = accept(listener, NULL, NULL), n;
+
+	if (fd < 0) return;
+	for (n = 0; n < MAX_NODES; n++) {
+		if (node[n].fd >= 0) continue;
+		memset(&node[n], 0, sizeof(node[n]));
+		node[n].fd = fd;
+		return;
+	}
+	fprintf(stderr, "canbusd: more than %d nodes\n", MAX_NODES);
+	close(fd);
+}
+
+void read_node(int n, unsigned long long now) {
+	CanBusMsg msg;
+	ssize_t len;
+
+	while ((len = recv(node[n].fd, &msg, sizeof(msg), MSG_DONTWAIT)) == sizeof(msg)) {
+		switch (msg.type) {
+			case CANBUS_HELLO:
+				node[n].bit_ps = msg.bit_ps;
+				if (!bus_bit) bus_bit = msg.bit_ps;
+				break;
+			case CANBUS_TX:
+				// A node has one frame on the bus at a time
+				if (n == tx) break;
+				node[n].frame = msg;
+				node[n].bit_ps = msg.bit_ps;
+				if (!node[n].pending && !node[n].retry) node[n].requested = now;
+				node[n].pending = 1;
+				break;
+		}
+	}
+	if (len == 0) drop_node(n);
+}
+
+void report() {
+	unsigned long long elapsed = now_ns() - started;
+	unsigned int id;
+	IdStats *s;
+
+	fprintf(stderr, "\ncanbusd: %.3f s at %.0f bit/s, %lu frames, %lu errors, bus load %.1f%%\n",
+			elapsed / 1e9, bus_bit ? 1e12 / bus_bit : 0.0, frames, errors,
+			elapsed ? 100.0 * busy / elapsed : 0.0);
+	for (id = 0; id < IDS; id++) {
+		s = &id_stats[id];
+		if (!s->frames && !s->errors) continue;
+		fprintf(stderr, "canbusd: id %4u %8lu frames %6lu errors, wait avg %6.1f max %6.1f us, latency avg %6.1f max %6.1f us\n",
+				id, s->frames, s->errors,
+				s->wait_total / 1e3 / (s->frames + s->errors), s->wait_max / 1e3,
+				s->frames ? s->lat_total / 1e3 / s->frames : 0.0, s->lat_max / 1e3);
+	}
+}
+
+void on_signal(int sig) {
+	if (sig == SIGUSR1) report_now = 1;
+	else quit = 1;
+}
@@ -0,0 +1,55 @@
+/* capture.c - Escritura y lectura de las capturas de capture.h. */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture.h"
+
+void *CaptureCreate(const char *path, uint32_t bit_ps) {
+	CaptureHeader header;
+	FILE *file = fopen(path, "wb");
+
+	if (!file) return NULL;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.record_size = sizeof(CaptureRecord);
+	header.bit_ps = bit_ps;
+	fwrite(&header, sizeof(header), 1, file);
+	return file;
+}
+
+void CaptureWrite(void *capture, const CaptureRecord *record) {
+	fwrite(record, sizeof(*record), 1, (FILE *)capture);
+}
+
+void CaptureClose(void *capture) {
+	fclose((FILE *)capture);
+}
+
+const CaptureRecord *CaptureMap(const char *path, unsigned long *count, uint32_t *bit_ps) {
+	const CaptureHeader *header;
+	struct stat st;
+	void *map;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(CaptureHeader)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return NULL;
+
+	header = map;
+	if (memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->record_size != sizeof(CaptureRecord)) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	*count = (st.st_size - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+	if (bit_ps) *bit_ps = header->bit_ps;
+	return (const CaptureRecord *)(header + 1);
+}
@@ -0,0 +1,39 @@
+/* capture.h - Formato de las capturas del tráfico del bus CAN virtual. */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+// A capture is a header followed by fixed size records in the order of the
+// bus, so that it can be mapped and indexed in place. The record count follows
+// from the file size: a capture cut short is still valid up to its last record.
+#define CAPTURE_MAGIC	"CANCAP1"
+
+typedef struct {
+	char magic[8];					// CAPTURE_MAGIC
+	uint32_t record_size;			// sizeof(CaptureRecord)
+	uint32_t bit_ps;				// Bit time of the bus, 0 if unknown
+} CaptureHeader;
+
+#define CAPTURE_ERROR	0x01		// Frame ended by an error frame
+
+typedef struct {
+	uint64_t time_ns;				// End of the frame, since the capture started
+	uint16_t id;
+	uint8_t dlc;
+	uint8_t flags;
+	uint16_t data[4];
+	uint16_t node;					// Slot of the transmitter on the bus
+	uint16_t bits;					// Bits on the wire
+} CaptureRecord;
+
+// Start a capture, NULL if the file can't be written
+void *CaptureCreate(const char *path, uint32_t bit_ps);
+void CaptureWrite(void *capture, const CaptureRecord *record);
+void CaptureClose(void *capture);
+
+// Map a capture for reading, NULL if it isn't one. count receives the number
+// of records.
+const CaptureRecord *CaptureMap(const char *path, unsigned long *count, uint32_t *bit_ps);
+
+#endif
@@ -0,0 +1,300 @@
+/* p30f4011.h - Sustituto en el PC de la cabecera de registros del dsPIC30F4011. */
+/* Only the registers and bits used by the nodes of the game. Plain registers are
+ * variables that sim.c reads and updates on every simulation tick; the ones with
+ * side effects on access (timer counts, UART data) go through sim.c functions. */
+#ifndef __30F4011_H
+#define __30F4011_H
+
+/* Configuration words and attributes have no meaning on the host */
+#define _FOSC(x)
+#define _FWDT(x)
+#define _FBORPOR(x)
+#define _FGS(x)
+#define _ISR
+#define _ISRFAST
+
+/* Every register is a word that can also be accessed through its bit fields */
+#define SIM_REG(name, fields) \
+	typedef union { unsigned int w; struct { fields } b; } name##_t; \
+	extern volatile name##_t sim_##name
+#define SIM_WORD(name) extern volatile unsigned int name
+
+/* CPU */
+SIM_REG(SR, unsigned C:1; unsigned Z:1; unsigned OV:1; unsigned N:1; unsigned RA:1;
+	unsigned IPL:3; unsigned DC:1; unsigned DA:1; unsigned SAB:1; unsigned OAB:1;
+	unsigned SB:1; unsigned SA:1; unsigned OB:1; unsigned OA:1;);
+#define SR			sim_SR.w
+#define SRbits		sim_SR.b
+
+/* Interrupt controller */
+SIM_REG(IFS0, unsigned INT0IF:1; unsigned IC1IF:1; unsigned OC1IF:1; unsigned T1IF:1;
+	unsigned IC2IF:1; unsigned OC2IF:1; unsigned T2IF:1; unsigned T3IF:1;
+	unsigned SPI1IF:1; unsigned U1RXIF:1; unsigned U1TXIF:1; unsigned ADIF:1;
+	unsigned NVMIF:1; unsigned SI2CIF:1; unsigned MI2CIF:1; unsigned CNIF:1;);
+SIM_REG(IEC0, unsigned INT0IE:1; unsigned IC1IE:1; unsigned OC1IE:1; unsigned T1IE:1;
+	unsigned IC2IE:1; unsigned OC2IE:1; unsigned T2IE:1; unsigned T3IE:1;
+	unsigned SPI1IE:1; unsigned U1RXIE:1; unsigned U1TXIE:1; unsigned ADIE:1;
+	unsigned NVMIE:1; unsigned SI2CIE:1; unsigned MI2CIE:1; unsigned CNIE:1;);
+SIM_REG(IFS1, unsigned INT1IF:1; unsigned IC7IF:1; unsigned IC8IF:1; unsigned OC3IF:1;
+	unsigned OC4IF:1; unsigned T4IF:1; unsigned T5IF:1; unsigned INT2IF:1;
+	unsigned U2RXIF:1; unsigned U2TXIF:1; unsigned SPI2IF:1; unsigned C1IF:1;
+	unsigned :4;);
+SIM_REG(IEC1, unsigned INT1IE:1; unsigned IC7IE:1; unsigned IC8IE:1; unsigned OC3IE:1;
+	unsigned OC4IE:1; unsigned T4IE:1; unsigned T5IE:1; unsigned INT2IE:1;
+	unsigned U2RXIE:1; unsigned U2TXIE:1; unsigned SPI2IE:1; unsigned C1IE:1;
+	unsigned :4;);
+#define IFS0		sim_IFS0.w
+#define IFS0bits	sim_IFS0.b
+#define IEC0		sim_IEC0.w
+#define IEC0bits	sim_IEC0.b
+#define IFS1		sim_IFS1.w
+#define IFS1bits	sim_IFS1.b
+#define IEC1		sim_IEC1.w
+#define IEC1bits	sim_IEC1.b
+
+/* Ports */
+SIM_REG(TRISB, unsigned TRISB0:1; unsigned TRISB1:1; unsigned TRISB2:1; unsigned TRISB3:1;
+	unsigned TRISB4:1; unsigned TRISB5:1; unsigned TRISB6:1; unsigned TRISB7:1;
+	unsigned TRISB8:1; unsigned :7;);
+#define TRISB		sim_TRISB.w
+#define TRISBbits	sim_TRISB.b
+
+/* Timers */
+SIM_REG(T1CON, unsigned :1; unsigned TCS:1; unsigned TSYNC:1; unsigned :1;
+	unsigned TCKPS:2; unsigned TGATE:1; unsigned :6; unsigned TSIDL:1; unsigned :1;
+	unsigned TON:1;);
+SIM_REG(T2CON, unsigned :1; unsigned TCS:1; unsigned :1; unsigned T32:1;
+	unsigned TCKPS:2; unsigned TGATE:1; unsigned :6; unsigned TSIDL:1; unsigned :1;
+	unsigned TON:1;);
+SIM_REG(T3CON, unsigned :1; unsigned TCS:1; unsigned :2;
+	unsigned TCKPS:2; unsigned TGATE:1; unsigned :6; unsigned TSIDL:1; unsigned :1;
+	unsigned TON:1;);
+#define T1CON		sim_T1CON.w
+#define T1CONbits	sim_T1CON.b
+#define T2CON		sim_T2CON.w
+#define T2CONbits	sim_T2CON.b
+#define T3CON		sim_T3CON.w
+#define T3CONbits	sim_T3CON.b
+SIM_WORD(PR1);
+SIM_WORD(PR2);
+SIM_WORD(PR3);
+SIM_WORD(TMR3HLD);
+/* Counts brought up to date on every access, reading TMR2 in 32-bit mode
+ * latches TMR3 into TMR3HLD */
+volatile unsigned int *sim_timer(int n);
+#define TMR1		(*sim_timer(1))
+#define TMR2		(*sim_timer(2))
+#define TMR3		(*sim_timer(3))
+
+/* UART1 */
+SIM_REG(U1MODE, unsigned STSEL:1; unsigned PDSEL:2; unsigned :2; unsigned ABAUD:1;
+	unsigned LPBACK:1; unsigned WAKE:1; unsigned :2; unsigned ALTIO:1; unsigned :2;
+	unsigned USIDL:1; unsigned :1; unsigned UARTEN:1;);
+SIM_REG(U1STA, unsigned URXDA:1; unsigned OERR:1; unsigned FERR:1; unsigned PERR:1;
+	unsigned RIDLE:1; unsigned ADDEN:1; unsigned URXISEL:2; unsigned TRMT:1;
+	unsigned UTXBF:1; unsigned UTXEN:1; unsigned UTXBRK:1; unsigned :3;
+	unsigned UTXISEL:1;);
+#define U1MODE		sim_U1MODE.w
+#define U1MODEbits	sim_U1MODE.b
+#define U1STA		sim_U1STA.w
+#define U1STAbits	sim_U1STA.b
+SIM_WORD(U1BRG);
+/* Writing U1TXREG queues a byte in the transmit FIFO, reading U1RXREG takes one
+ * from the receive FIFO */
+volatile unsigned int *sim_uart_tx(void);
+unsigned int sim_uart_rx(void);
+#define U1TXREG		(*sim_uart_tx())
+#define U1RXREG		(sim_uart_rx())
+
+/* ADC */
+SIM_REG(ADCON1, unsigned DONE:1; unsigned SAMP:1; unsigned ASAM:1; unsigned SIMSAM:1;
+	unsigned :1; unsigned SSRC:3; unsigned FORM:2; unsigned :3; unsigned ADSIDL:1;
+	unsigned :1; unsigned ADON:1;);
+SIM_REG(ADCON2, unsigned ALTS:1; unsigned BUFM:1; unsigned SMPI:4; unsigned :1;
+	unsigned BUFS:1; unsigned CHPS:2; unsigned CSCNA:1; unsigned :2; unsigned VCFG:3;);
+SIM_REG(ADCON3, unsigned ADCS:6; unsigned :1; unsigned ADRC:1; unsigned SAMC:5;
+	unsigned :3;);
+#define ADCON1		sim_ADCON1.w
+#define ADCON1bits	sim_ADCON1.b
+#define ADCON2		sim_ADCON2.w
+#define ADCON2bits	sim_ADCON2.b
+#define ADCON3		sim_ADCON3.w
+#define ADCON3bits	sim_ADCON3.b
+SIM_WORD(ADCHS);
+SIM_WORD(ADPCFG);
+SIM_WORD(ADCSSL);
+extern volatile unsigned int sim_ADCBUF[16];
+#define ADCBUF0		sim_ADCBUF[0]
+#define ADCBUF1		sim_ADCBUF[1]
+#define ADCBUF2		sim_ADCBUF[2]
+#define ADCBUF3		sim_ADCBUF[3]
+#define ADCBUF4		sim_ADCBUF[4]
+#define ADCBUF5		sim_ADCBUF[5]
+#define ADCBUF6		sim_ADCBUF[6]
+#define ADCBUF7		sim_ADCBUF[7]
+#define ADCBUF8		sim_ADCBUF[8]
+#define ADCBUF9		sim_ADCBUF[9]
+#define ADCBUFA		sim_ADCBUF[10]
+#define ADCBUFB		sim_ADCBUF[11]
+#define ADCBUFC		sim_ADCBUF[12]
+#define ADCBUFD		sim_ADCBUF[13]
+#define ADCBUFE		sim_ADCBUF[14]
+#define ADCBUFF		sim_ADCBUF[15]
+
+/* CAN1 */
+SIM_REG(C1CTRL, unsigned :1; unsigned ICODE:3; unsigned :1; unsigned OPMODE:3;
+	unsigned REQOP:3; unsigned CANCKS:1; unsigned ABAT:1; unsigned CSIDL:1;
+	unsigned :1; unsigned CANCAP:1;);
+SIM_REG(C1CFG1, unsigned BRP:6; unsigned SJW:2; unsigned :8;);
+SIM_REG(C1CFG2, unsigned PRSEG:3; unsigned SEG1PH:3; unsigned SAM:1; unsigned SEG2PHTS:1;
+	unsigned SEG2PH:3; unsigned :3; unsigned WAKFIL:1; unsigned :1;);
+SIM_REG(C1INTF, unsigned RX0IF:1; unsigned RX1IF:1; unsigned TX0IF:1; unsigned TX1IF:1;
+	unsigned TX2IF:1; unsigned ERRIF:1; unsigned WAKIF:1; unsigned IVRIF:1;
+	unsigned EWARN:1; unsigned RXWAR:1; unsigned TXWAR:1; unsigned RXEP:1;
+	unsigned TXEP:1; unsigned TXBO:1; unsigned RX1OVR:1; unsigned RX0OVR:1;);
+SIM_REG(C1INTE, unsigned RX0IE:1; unsigned RX1IE:1; unsigned TX0IE:1; unsigned TX1IE:1;
+	unsigned TX2IE:1; unsigned ERRIE:1; unsigned WAKIE:1; unsigned IVRIE:1;
+	unsigned :8;);
+SIM_REG(C1EC, unsigned RERRCNT:8; unsigned TERRCNT:8;);
+#define C1CTRL		sim_C1CTRL.w
+#define C1CTRLbits	sim_C1CTRL.b
+#define C1CFG1		sim_C1CFG1.w
+#define C1CFG1bits	sim_C1CFG1.b
+#define C1CFG2		sim_C1CFG2.w
+#define C1CFG2bits	sim_C1CFG2.b
+#define C1INTF		sim_C1INTF.w
+#define C1INTFbits	sim_C1INTF.b
+#define C1INTE		sim_C1INTE.w
+#define C1INTEbits	sim_C1INTE.b
+#define C1EC		sim_C1EC.w
+#define C1ECbits	sim_C1EC.b
+
+/* CAN1 transmit buffers */
+typedef struct {
+	union { unsigned int w; struct { unsigned TXPRI:2; unsigned :1; unsigned TXREQ:1;
+		unsigned TXERR:1; unsigned TXLARB:1; unsigned TXABT:1; unsigned :9; } b; } con;
+	union { unsigned int w; struct { unsigned TXIDE:1; unsigned SRR:1; unsigned SID5_0:6;
+		unsigned :3; unsigned SID10_6:5; } b; } sid;
+	union { unsigned int w; struct { unsigned EID13_6:8; unsigned :4;
+		unsigned EID17_14:4; } b; } eid;
+	union { unsigned int w; struct { unsigned :3; unsigned DLC:4; unsigned TXRB0:1;
+		unsigned TXRB1:1; unsigned TXRTR:1; unsigned EID5_0:6; } b; } dlc;
+	unsigned int data[4];
+} sim_CANTX_t;
+extern volatile sim_CANTX_t sim_C1TX[3];
+#define C1TX0CON		sim_C1TX[0].con.w
+#define C1TX0CONbits	sim_C1TX[0].con.b
+#define C1TX0SID		sim_C1TX[0].sid.w
+#define C1TX0SIDbits	sim_C1TX[0].sid.b
+#define C1TX0EID		sim_C1TX[0].eid.w
+#define C1TX0EIDbits	sim_C1TX[0].eid.b
+#define C1TX0DLC		sim_C1TX[0].dlc.w
+#define C1TX0DLCbits	sim_C1TX[0].dlc.b
+#define C1TX0B1			sim_C1TX[0].data[0]
+#define C1TX0B2			sim_C1TX[0].data[1]
+#define C1TX0B3			sim_C1TX[0].data[2]
+#define C1TX0B4			sim_C1TX[0].data[3]
+#define C1TX1CON		sim_C1TX[1].con.w
+#define C1TX1CONbits	sim_C1TX[1].con.b
+#define C1TX1SID		sim_C1TX[1].sid.w
+#define C1TX1SIDbits	sim_C1TX[1].sid.b
+#define C1TX1EID		sim_C1TX[1].eid.w
+#define C1TX1EIDbits	sim_C1TX[1].eid.b
+#define C1TX1DLC		sim_C1TX[1].dlc.w
+#define C1TX1DLCbits	sim_C1TX[1].dlc.b
+#define C1TX1B1			sim_C1TX[1].data[0]
+#define C1TX1B2			sim_C1TX[1].data[1]
+#define C1TX1B3			sim_C1TX[1].data[2]
+#define C1TX1B4			sim_C1TX[1].data[3]
+#define C1TX2CON		sim_C1TX[2].con.w
+#define C1TX2CONbits	sim_C1TX[2].con.b
+#define C1TX2SID		sim_C1TX[2].sid.w
+#define C1TX2SIDbits	sim_C1TX[2].sid.b
+#define C1TX2EID		sim_C1TX[2].eid.w
+#define C1TX2EIDbits	sim_C1TX[2].eid.b
+#define C1TX2DLC		sim_C1TX[2].dlc.w
+#define C1TX2DLCbits	sim_C1TX[2].dlc.b
+#define C1TX2B1			sim_C1TX[2].data[0]
+#define C1TX2B2			sim_C1TX[2].data[1]
+#define C1TX2B3			sim_C1TX[2].data[2]
+#define C1TX2B4			sim_C1TX[2].data[3]
+
+/* CAN1 receive buffers */
+typedef struct {
+	union { unsigned int w; struct { unsigned FILHIT0:1; unsigned JTOFF:1; unsigned DBEN:1;
+		unsigned RXRTRRO:1; unsigned :3; unsigned RXFUL:1; unsigned :8; } b;
+		struct { unsigned FILHIT:3; unsigned RXRTRRO:1; unsigned :3; unsigned RXFUL:1;
+		unsigned :8; } b1; } con;		/* b: buffer 0, b1: buffer 1 */
+	union { unsigned int w; struct { unsigned RXIDE:1; unsigned SRR:1; unsigned SID:11;
+		unsigned :3; } b; } sid;
+	unsigned int eid;
+	union { unsigned int w; struct { unsigned DLC:4; unsigned RXRB0:1; unsigned :3;
+		unsigned RXRB1:1; unsigned RXRTR:1; unsigned EID5_0:6; } b; } dlc;
+	unsigned int data[4];
+} sim_CANRX_t;
+extern volatile sim_CANRX_t sim_C1RX[2];
+#define C1RX0CON		sim_C1RX[0].con.w
+#define C1RX0CONbits	sim_C1RX[0].con.b
+#define C1RX0SID		sim_C1RX[0].sid.w
+#define C1RX0SIDbits	sim_C1RX[0].sid.b
+#define C1RX0DLC		sim_C1RX[0].dlc.w
+#define C1RX0DLCbits	sim_C1RX[0].dlc.b
+#define C1RX0B1			sim_C1RX[0].data[0]
+#define C1RX0B2			sim_C1RX[0].data[1]
+#define C1RX0B3			sim_C1RX[0].data[2]
+#define C1RX0B4			sim_C1RX[0].data[3]
+#define C1RX1CON		sim_C1RX[1].con.w
+#define C1RX1CONbits	sim_C1RX[1].con.b1
+#define C1RX1SID		sim_C1RX[1].sid.w
+#define C1RX1SIDbits	sim_C1RX[1].sid.b
+#define C1RX1DLC		sim_C1RX[1].dlc.w
+#define C1RX1DLCbits	sim_C1RX[1].dlc.b
+#define C1RX1B1			sim_C1RX[1].data[0]
+#define C1RX1B2			sim_C1RX[1].data[1]
+#define C1RX1B3			sim_C1RX[1].data[2]
+#define C1RX1B4			sim_C1RX[1].data[3]
+
+/* CAN1 acceptance masks and filters */
+typedef union { unsigned int w; struct { unsigned MIDE:1; unsigned :1; unsigned SID:11;
+	unsigned :3; } b; } sim_CANMASK_t;
+typedef union { unsigned int w; struct { unsigned EXIDE:1; unsigned :1; unsigned SID:11;
+	unsigned :3; } b; } sim_CANFILT_t;
+extern volatile sim_CANMASK_t sim_C1RXM[2];
+extern volatile sim_CANFILT_t sim_C1RXF[6];
+#define C1RXM0SID		sim_C1RXM[0].w
+#define C1RXM0SIDbits	sim_C1RXM[0].b
+#define C1RXM1SID		sim_C1RXM[1].w
+#define C1RXM1SIDbits	sim_C1RXM[1].b
+#define C1RXF0SID		sim_C1RXF[0].w
+#define C1RXF0SIDbits	sim_C1RXF[0].b
+#define C1RXF1SID		sim_C1RXF[1].w
+#define C1RXF1SIDbits	sim_C1RXF[1].b
+#define C1RXF2SID		sim_C1RXF[2].w
+#define C1RXF2SIDbits	sim_C1RXF[2].b
+#define C1RXF3SID		sim_C1RXF[3].w
+#define C1RXF3SIDbits	sim_C1RXF[3].b
+#define C1RXF4SID		sim_C1RXF[4].w
+#define C1RXF4SIDbits	sim_C1RXF[4].b
+#define C1RXF5SID		sim_C1RXF[5].w
+#define C1RXF5SIDbits	sim_C1RXF[5].b
+
+/* Power saving and miscellaneous instructions. Idle() serves the interrupt that
+ * wakes the CPU up as if the priority raised around it had been restored. */
+void sim_idle(void);
+#define Idle()		sim_idle()
+#define Sleep()		sim_idle()
+/* Called by IRQ_RESTORE of irq.h to serve at once the interrupts a tick found
+ * held back by the raised priority. */
+void sim_ipl_lowered(void);
+#define SIM_IPL_LOWERED()	sim_ipl_lowered()
+/* Called by SeqCopy of seqlock.h after every word it copies, see SIM_PREEMPT in
+ * sim.c. */
+void sim_preempt(void);
+#define SIM_PREEMPT()		sim_preempt()
+#define Nop()
+#define ClrWdt()
+
+/* Delay routine provided by the board support library */
+void Delay5ms(void);
+
+#endif
@@ -0,0 +1,88 @@
+/* replay.c - Reproducción de una captura del bus CAN en un nodo simulado. */
+/* With SIM_REPLAY naming a capture (capture.h) the node takes its CAN traffic
+ * from it instead of a bus: every frame that ended without error is offered to
+ * the receive buffers, and so reaches the node's _C1Interrupt, at the time it
+ * had in the capture counted from the moment the node enters normal mode. With
+ * SIM_REPLAY_FAST set the next frame comes as soon as both receive buffers are
+ * empty, one each time the bus is polled: every simulation tick, and with
+ * SIM_PREEMPT (sim.c) every word of a seqlock copy too. The frames the node transmits are
+ * acknowledged at once. After the last frame and REPLAY_DRAIN_MS for the node
+ * to finish its work the replay prints its time to stderr and ends the node.
+ * The node runs on the stepped clock of sim.c, so the capture alone sets when
+ * its frames arrive, and the node's timers and ms count with them: a replay
+ * with the same keys draws the same bytes every time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include "p30f4011.h"
+#include "capture.h"
+#include "sim.h"
+
+#define REPLAY_DRAIN_MS		100
+
+static const CaptureRecord *records;
+static unsigned long count, next, delivered;
+static unsigned char fast, started;
+static unsigned long long start, last;		// Cycles of the first poll and the last frame
+
+static void replay_send(const SimCanFrame *frame) {
+	SimCanTxDone(1);
+}
+
+static void replay_poll() {
+	const CaptureRecord *r;
+	SimCanFrame frame;
+	unsigned long long now = SimCycles();
+	unsigned int i;
+
+	if (!started) {
+		started = 1;
+		start = last = now;
+	}
+
+	while (next < count) {
+		r = &records[next];
+		if (r->flags & CAPTURE_ERROR) {
+			next++;
+			continue;
+		}
+		if (fast) {
+			if (C1RX0CONbits.RXFUL || C1RX1CONbits.RXFUL) break;
+		} else if ((now - start) * 1000000000ULL / SIM_FCY < r->time_ns - records[0].time_ns) {
+			break;
+		}
+		frame.id = r->id;
+		frame.dlc = r->dlc;
+		for (i = 0; i < 4; i++) frame.data[i] = r->data[i];
+		SimCanDeliver(&frame);
+		delivered++;
+		last = now;
+		next++;
+		if (fast) break;
+	}
+
+	if (next == count && now - last >= SIM_FCY / 1000 * REPLAY_DRAIN_MS) {
+		fprintf(stderr, "replay: %lu frames in %.3f s (%.0f frames/s)\n", delivered,
+				(last - start) / (double)SIM_FCY,
+				(last > start) ? delivered * (double)SIM_FCY / (last - start) : 0.0);
+		next++;							// Only once
+		raise(SIGTERM);
+	}
+}
+
+static const SimCanBus replay_bus = {replay_send, replay_poll};
+
+__attribute__((constructor)) static void replay_start() {
+	const char *path = getenv("SIM_REPLAY");
+
+	if (!path) return;
+	records = CaptureMap(path, &count, NULL);
+	if (!records) {
+		fprintf(stderr, "%s: not a capture\n", path);
+		exit(1);
+	}
+	fast = getenv("SIM_REPLAY_FAST") != NULL;
+	SimCanAttach(&replay_bus);
+	SimStepClock();
+}
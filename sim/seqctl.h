@@ -0,0 +1,22 @@
+/* seqctl.h - Esclavo sin seqlock, control de la prueba de cortes. */
+/* Forced into a slave by the esclavo1c-ctl rule of the Makefile to build the
+ * control of test-stress as the slaves were before the seqlock: _C1Interrupt
+ * applies the CAN frames itself and the copies of the game state are never
+ * retried, so tearcheck must find torn balls in its output. The slave sources
+ * know nothing about it.
+ */
+#ifndef SEQCTL_H
+#define SEQCTL_H
+
+#include <p30f4011.h>					// SIM_PREEMPT before seqlock.h
+#include "../can.h"
+#include "../seqlock.h"
+
+// Every copy is kept, torn or not
+#define SeqReadRetry(seq, start)	((void)(seq), (void)(start), 0)
+
+// Frames applied in the interrupt as soon as they are received
+void process_messages();
+#define CANRxInterrupt()			(CANRxInterrupt(), process_messages())
+
+#endif
@@ -0,0 +1,796 @@
+/* sim.c - Implementación del simulador de sim.h y de los sustitutos de p30f4011.h y uart.h. */
+/* A periodic SIGALRM plays the peripheral clock: every SIM_TICK_US the timers,
+ * UART1, ADC and CAN1 are brought up to the real time elapsed, and the
+ * interrupts whose flag and enable bits are set are served by calling the
+ * node's _ISR handlers, as long as the CPU priority (SRbits.IPL) is below 4, the
+ * default priority of every source. An interrupt held back by a raised CPU
+ * priority is served as soon as the node restores it (IRQ_RESTORE of irq.h), as
+ * the CPU would, instead of waiting for the next tick. The UART is the terminal: stdout receives
+ * what the node transmits and stdin feeds the receiver at the baud rate.
+ *
+ * Environment: SIM_ADC pot value for the ADC (0-1023, default 512, SIGUSR1 and
+ * SIGUSR2 lower and raise it), SIM_NO_DELAY skips Delay5ms(), SIM_STATS prints
+ * interrupt counts and times to stderr on exit, SIM_PREEMPT brings the
+ * peripherals up to date and serves the pending interrupts after every word a
+ * SeqCopy() of seqlock.h copies, so interrupts land in the middle of the copies
+ * instead of once in a tick.
+ *
+ * After SimStepClock() (a replay, see replay.c) the time is no longer the real
+ * one: the clock advances SIM_STEP cycles at each call of the node into the
+ * simulator (a seqlock copy word, IRQ_RESTORE, a timer read, a UART write) and
+ * the tick runs there whenever the clock passes one, so the same inputs give
+ * the same run. SIGALRM then only moves the clock on, one tick at a time, when
+ * the node makes no call for SIM_STALLS alarms in a row: it is waiting in a
+ * loop for a flag that only a tick can change.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/time.h>
+#include "p30f4011.h"
+#include "uart.h"
+#include "sim.h"
+
+/******************************************************************************/
+/* Registers                                                                  */
+/******************************************************************************/
+#define SIM_DEFINE(name)	volatile name##_t sim_##name
+
+SIM_DEFINE(SR);
+SIM_DEFINE(IFS0);
+SIM_DEFINE(IEC0);
+SIM_DEFINE(IFS1);
+SIM_DEFINE(IEC1);
+SIM_DEFINE(TRISB);
+SIM_DEFINE(T1CON);
+SIM_DEFINE(T2CON);
+SIM_DEFINE(T3CON);
+SIM_DEFINE(U1MODE);
+SIM_DEFINE(U1STA);
+SIM_DEFINE(ADCON1);
+SIM_DEFINE(ADCON2);
+SIM_DEFINE(ADCON3);
+SIM_DEFINE(C1CTRL);
+SIM_DEFINE(C1CFG1);
+SIM_DEFINE(C1CFG2);
+SIM_DEFINE(C1INTF);
+SIM_DEFINE(C1INTE);
+SIM_DEFINE(C1EC);
+volatile unsigned int PR1 = 0xFFFF, PR2 = 0xFFFF, PR3 = 0xFFFF, TMR3HLD;
+volatile unsigned int U1BRG;
+volatile unsigned int ADCHS, ADPCFG, ADCSSL;
+volatile unsigned int sim_ADCBUF[16];
+volatile sim_CANTX_t sim_C1TX[3];
+volatile sim_CANRX_t sim_C1RX[2];
+volatile sim_CANMASK_t sim_C1RXM[2];
+volatile sim_CANFILT_t sim_C1RXF[6];
+
+/******************************************************************************/
+/* Interrupt handlers of the node, the ones it doesn't define are null        */
+/******************************************************************************/
+void _T1Interrupt(void) __attribute__((weak));
+void _T2Interrupt(void) __attribute__((weak));
+void _T3Interrupt(void) __attribute__((weak));
+void _U1RXInterrupt(void) __attribute__((weak));
+void _U1TXInterrupt(void) __attribute__((weak));
+void _ADCInterrupt(void) __attribute__((weak));
+void _C1Interrupt(void) __attribute__((weak));
+
+// Sources in natural order (vector number), the order of equal priorities
+enum {VEC_T1, VEC_T2, VEC_T3, VEC_U1RX, VEC_U1TX, VEC_ADC, VEC_C1, VECTORS};
+static const char *const vec_names[VECTORS] = {"T1", "T2", "T3", "U1RX", "U1TX", "ADC", "C1"};
+#define ISR_IPL		4			// Default priority of every source
+#define TICK_CYCLES	(SIM_FCY / 1000 * SIM_TICK_US / 1000)
+#define SIM_STEP	32			// Cycles of a call into the simulator on the stepped clock
+#define SIM_STALLS	20			// Alarms without a call before the stepped clock moves on
+
+/******************************************************************************/
+/* Simulation state                                                           */
+/******************************************************************************/
+static struct timespec start_time;
+static unsigned long long tick_cycles;			// Time of the last update
+static volatile sig_atomic_t held;				// Interrupts left pending by the last tick
+// Stepped clock of SimStepClock(): its time, and alarms since the node's last call
+static unsigned char stepped;
+static unsigned long long step_time;
+static volatile sig_atomic_t stalls;
+static sigset_t alarm_set, lock_mask;
+static int lock_depth;
+
+// Timers 1-3: count, time counted up to, and the count as the node last saw it
+// (tmr_seen), where its writes land. tmr_given is the count handed at the last
+// access: every write goes through an access, so tmr_seen only differs from it
+// after a write. A tick leaves tmr_seen alone, or a read just after the access
+// could see a newer count than the one latched in TMR3HLD.
+static unsigned int tmr[4];
+static unsigned long long tmr_time[4];
+static volatile unsigned int tmr_seen[4];
+static unsigned int tmr_given[4];
+
+// UART1: transmit FIFO and shift register, receive FIFO
+#define UART_FIFO	4
+#define UART_UNSET	0xFFFF		// Slot given to a write that hasn't stored its byte yet
+static volatile unsigned int tx_fifo[UART_FIFO + 1];	// Last one takes writes to a full FIFO
+static unsigned int tx_head, tx_count;
+static unsigned char tx_shift, tx_busy;
+static unsigned long long tx_done, tx_free;	// End of the byte being sent, shift register free since
+static unsigned char rx_fifo[UART_FIFO];
+static unsigned int rx_head, rx_count;
+static unsigned char rx_overrun;
+static unsigned long long rx_next;			// When the next byte can arrive
+static unsigned char out_buf[256];
+static unsigned int out_len;
+static struct termios saved_termios;
+static unsigned char termios_saved;
+
+// ADC: value of the pot on AN7, conversions done and buffer being filled
+static volatile int adc_value = 512;
+static unsigned long long adc_time;
+static unsigned int adc_index;
+
+// CAN1: buffer on the bus (-1: none) and when it ends
+static const SimCanBus *can_bus;
+static int can_tx = -1;
+static unsigned long long can_tx_done, can_free;
+
+// Interrupts served in the middle of the seqlock copies
+static unsigned char preempt;
+// Statistics
+static unsigned char stats;
+static unsigned long isr_count[VECTORS], isr_total;
+static unsigned long long isr_cycles[VECTORS], isr_max[VECTORS];
+static unsigned long can_sent, can_received, can_lost, can_errors;
+static unsigned long uart_sent, uart_received, uart_overruns;
+
+/******************************************************************************/
+/* Time and locking                                                           */
+/******************************************************************************/
+unsigned long long SimCycles() {
+	struct timespec now;
+	unsigned long long ns;
+
+	if (stepped) return step_time;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - start_time.tv_sec) * 1000000000ULL + now.tv_nsec - start_time.tv_nsec;
+	return ns * (SIM_FCY / 100) / 10000000ULL;
+}
+
+void SimLock() {
+	sigset_t old;
+
+	sigprocmask(SIG_BLOCK, &alarm_set, &old);
+	if (lock_depth++ == 0) lock_mask = old;
+}
+
+void SimUnlock() {
+	if (--lock_depth == 0) sigprocmask(SIG_SETMASK, &lock_mask, NULL);
+}
+
+void SimStepClock() {
+	SimLock();
+	step_time = SimCycles();
+	stepped = 1;
+	SimUnlock();
+}
+
+static void tick(int sig);
+
+/* Moves the stepped clock on, with a tick at every one it passes. Interrupt
+ * handlers and the simulator itself only move the clock: their tick comes at
+ * the next call of the main program.
+ */
+static void advance(unsigned long long cycles) {
+	step_time += cycles;
+	if (lock_depth == 0 && step_time - tick_cycles >= TICK_CYCLES) tick(0);
+}
+
+/* A call of the node into the simulator, which takes SIM_STEP cycles
+ */
+static void step() {
+	if (!stepped) return;
+	stalls = 0;
+	advance(SIM_STEP);
+}
+
+/******************************************************************************/
+/* Timers                                                                     */
+/******************************************************************************/
+static const unsigned int prescaler[4] = {1, 8, 64, 256};
+
+/* Counts with a prescaler and period until now, returns the periods completed
+ */
+static unsigned long long count(unsigned int n, unsigned int on, unsigned int ckps,
+								unsigned long long period, unsigned long long *value,
+								unsigned long long now) {
+	unsigned long long counts, periods = 0;
+
+	counts = (now - tmr_time[n]) / prescaler[ckps];
+	tmr_time[n] += counts * prescaler[ckps];
+	if (!on) return 0;
+	*value += counts;
+	if (*value >= period) {
+		periods = *value / period;
+		*value %= period;
+	}
+	return periods;
+}
+
+static void timers_update(unsigned long long now) {
+	unsigned long long value;
+	int n;
+
+	// Counts written by the node since it last read them
+	for (n = 1; n <= 3; n++) if (tmr_seen[n] != tmr_given[n]) tmr[n] = tmr_given[n] = tmr_seen[n];
+
+	value = tmr[1];
+	if (count(1, T1CONbits.TON, T1CONbits.TCKPS, PR1 + 1ULL, &value, now)) IFS0bits.T1IF = 1;
+	tmr[1] = value;
+
+	if (T2CONbits.T32) {
+		// Timer2 and Timer3 as one 32-bit timer, Timer3 interrupt
+		value = tmr[2] | ((unsigned long long)tmr[3] << 16);
+		if (count(2, T2CONbits.TON, T2CONbits.TCKPS, (PR2 | ((unsigned long long)PR3 << 16)) + 1ULL,
+				  &value, now))
+			IFS0bits.T3IF = 1;
+		tmr[2] = value & 0xFFFF;
+		tmr[3] = value >> 16;
+		tmr_time[3] = tmr_time[2];
+	} else {
+		value = tmr[2];
+		if (count(2, T2CONbits.TON, T2CONbits.TCKPS, PR2 + 1ULL, &value, now)) IFS0bits.T2IF = 1;
+		tmr[2] = value;
+		value = tmr[3];
+		if (count(3, T3CONbits.TON, T3CONbits.TCKPS, PR3 + 1ULL, &value, now)) IFS0bits.T3IF = 1;
+		tmr[3] = value;
+	}
+}
+
+volatile unsigned int *sim_timer(int n) {
+	// The node reads and writes a copy of the count, a write is taken at the
+	// next access or tick
+	step();
+	SimLock();
+	timers_update(SimCycles());
+	tmr_seen[n] = tmr_given[n] = tmr[n];
+	if (n == 2 && T2CONbits.T32) TMR3HLD = tmr[3];
+	SimUnlock();
+	return &tmr_seen[n];
+}
+
+/******************************************************************************/
+/* UART1                                                                      */
+/******************************************************************************/
+/* Cycles to send or receive a character: start, 8 data bits and stop
+ */
+static unsigned long long uart_char() {
+	return 10ULL * 16 * (U1BRG + 1);
+}
+
+static void uart_flush() {
+	if (out_len > 0 && write(1, out_buf, out_len) < 0) {}
+	out_len = 0;
+}
+
+static void uart_status() {
+	U1STAbits.UTXBF = (tx_count == UART_FIFO);
+	U1STAbits.TRMT = (tx_count == 0 && !tx_busy);
+	U1STAbits.URXDA = (rx_count > 0);
+}
+
+static void uart_update(unsigned long long now) {
+	struct pollfd fd = {0, POLLIN, 0};
+	unsigned char c;
+
+	// Transmitter: the shift register takes the FIFO bytes one after another
+	while (1) {
+		if (tx_busy && now >= tx_done) {
+			out_buf[out_len++] = tx_shift;
+			if (out_len == sizeof(out_buf)) uart_flush();
+			uart_sent++;
+			tx_busy = 0;
+			tx_free = tx_done;
+		}
+		// A tick between the write to U1TXREG and the store waits for the byte
+		if (tx_busy || tx_count == 0 || tx_fifo[tx_head] == UART_UNSET) break;
+		tx_shift = tx_fifo[tx_head];
+		tx_head = (tx_head + 1) % UART_FIFO;
+		tx_count--;
+		tx_done = tx_free + uart_char();
+		tx_busy = 1;
+		// UTXISEL 0: every byte moved to the shift register, 1: FIFO empty
+		if (!U1STAbits.UTXISEL || tx_count == 0) IFS0bits.U1TXIF = 1;
+	}
+
+	// Receiver: a byte from stdin every character time at most
+	if (rx_overrun && !U1STAbits.OERR) {
+		// Clearing OERR empties the FIFO
+		rx_overrun = 0;
+		rx_count = 0;
+	}
+	if (now >= rx_next && poll(&fd, 1, 0) > 0 && (fd.revents & POLLIN) && read(0, &c, 1) == 1) {
+		rx_next = now + uart_char();
+		uart_received++;
+		if (rx_overrun || rx_count == UART_FIFO) {
+			// Reception stops until OERR is cleared
+			if (!rx_overrun) uart_overruns++;
+			rx_overrun = 1;
+			U1STAbits.OERR = 1;
+		} else {
+			rx_fifo[(rx_head + rx_count) % UART_FIFO] = c;
+			rx_count++;
+			// URXISEL 0-1: every byte, 2: 3 bytes, 3: 4 bytes
+			if (U1STAbits.URXISEL < 2 || rx_count >= U1STAbits.URXISEL + 1u) IFS0bits.U1RXIF = 1;
+		}
+	}
+	uart_status();
+}
+
+volatile unsigned int *sim_uart_tx() {
+	volatile unsigned int *slot;
+	unsigned long long now;
+
+	step();
+	SimLock();
+	now = SimCycles();
+	uart_update(now);
+	if (tx_count == UART_FIFO) {
+		slot = &tx_fifo[UART_FIFO];			// Full: the byte is lost
+	} else {
+		// The byte is stored after returning, the shift register takes it later
+		slot = &tx_fifo[(tx_head + tx_count) % UART_FIFO];
+		*slot = UART_UNSET;
+		if (!tx_busy && tx_count == 0 && tx_free < now) tx_free = now;
+		tx_count++;
+	}
+	uart_status();
+	U1STAbits.TRMT = 0;
+	SimUnlock();
+	return slot;
+}
+
+unsigned int sim_uart_rx() {
+	unsigned int c = 0;
+
+	SimLock();
+	if (rx_count > 0) {
+		c = rx_fifo[rx_head];
+		rx_head = (rx_head + 1) % UART_FIFO;
+		rx_count--;
+	}
+	uart_status();
+	SimUnlock();
+	return c;
+}
+
+void OpenUART1(unsigned int config1, unsigned int config2, unsigned int ubrg) {
+	U1MODE = config1;
+	U1STA = config2 & 0xFC00;		// Status bits are read only
+	U1BRG = ubrg;
+	uart_status();
+}
+
+void CloseUART1() {
+	U1MODE = 0;
+}
+
+void WriteUART1(unsigned int data) {
+	U1TXREG = data;
+}
+
+unsigned int ReadUART1() {
+	return U1RXREG;
+}
+
+char BusyUART1() {
+	SimLock();
+	uart_update(SimCycles());
+	SimUnlock();
+	return !U1STAbits.TRMT;
+}
+
+char DataRdyUART1() {
+	return U1STAbits.URXDA;
+}
+
+void putsUART1(unsigned int *buffer) {
+	const char *c = (const char *)buffer;
+
+	while (*c) {
+		while (U1STAbits.UTXBF);
+		U1TXREG = *c++;
+	}
+}
+
+/******************************************************************************/
+/* ADC                                                                        */
+/******************************************************************************/
+static void adc_update(unsigned long long now) {
+	unsigned long long conv;
+
+	// Auto sample and auto convert: (SAMC + 12) TAD per conversion, TAD of
+	// (ADCS + 1) / 2 cycles
+	if (!ADCON1bits.ADON || ADCON1bits.SSRC != 7 || !ADCON1bits.ASAM) {
+		adc_time = now;
+		return;
+	}
+	conv = (ADCON3bits.SAMC + 12ULL) * (ADCON3bits.ADCS + 1) / 2;
+	if (conv == 0) conv = 1;
+	while (now - adc_time >= conv) {
+		adc_time += conv;
+		sim_ADCBUF[adc_index] = adc_value;
+		if (++adc_index > ADCON2bits.SMPI) {
+			adc_index = 0;
+			IFS0bits.ADIF = 1;
+		}
+	}
+}
+
+static void adc_adjust(int sig) {
+	int value = adc_value + ((sig == SIGUSR2) ? 64 : -64);
+
+	adc_value = (value < 0) ? 0 : (value > 1023) ? 1023 : value;
+}
+
+/******************************************************************************/
+/* CAN1                                                                       */
+/******************************************************************************/
+#define CAN_TX(n)	(&sim_C1TX[n])
+
+/* Bit time of C1CFG1/C1CFG2 in quarters of a cycle: TQ = 2 (BRP + 1) / FCAN,
+ * FCAN = FCY with CANCKS, else 4 FCY
+ */
+static unsigned long long can_bit4() {
+	unsigned long long tq2 = 2ULL * (C1CFG1bits.BRP + 1);
+	unsigned long long tqs = 4ULL + C1CFG2bits.PRSEG + C1CFG2bits.SEG1PH + C1CFG2bits.SEG2PH;
+
+	return C1CTRLbits.CANCKS ? 4 * tq2 * tqs : tq2 * tqs;
+}
+
+/* Cycles of a frame on the bus without a bus process: 47 bits of overhead plus
+ * the data
+ */
+static unsigned long long can_frame(unsigned int dlc) {
+	return ((47ULL + 8*dlc) * can_bit4() + 3) / 4;
+}
+
+unsigned long SimCanBitTime() {
+	return can_bit4() * 250000000000ULL / SIM_FCY;
+}
+
+/* Reads the frame of a tx buffer
+ */
+static void can_load(int n, SimCanFrame *frame) {
+	frame->id = CAN_TX(n)->sid.b.SID5_0 | (CAN_TX(n)->sid.b.SID10_6 << 6);
+	frame->dlc = CAN_TX(n)->dlc.b.DLC;
+	memcpy(frame->data, (const void *)CAN_TX(n)->data, sizeof(frame->data));
+}
+
+static void can_raise() {
+	if (C1INTF & C1INTE & 0xFF) IFS1bits.C1IF = 1;
+}
+
+/* The buffer on the bus was sent: release it and raise its interrupt
+ */
+static void can_sent_ok() {
+	CAN_TX(can_tx)->con.b.TXREQ = 0;
+	CAN_TX(can_tx)->con.b.TXERR = 0;
+	C1INTF |= 1 << (2 + can_tx);			// TX0IF-TX2IF
+	if (C1ECbits.TERRCNT > 0) C1ECbits.TERRCNT--;
+	can_sent++;
+	can_tx = -1;
+	can_raise();
+}
+
+void SimCanTxDone(unsigned char acked) {
+	if (can_tx < 0) return;
+	if (acked) {
+		can_sent_ok();
+	} else {
+		// Error frame: the buffer keeps its request and is sent again
+		CAN_TX(can_tx)->con.b.TXERR = 1;
+		if (C1ECbits.TERRCNT < 248) C1ECbits.TERRCNT += 8;
+		can_errors++;
+		can_tx = -1;
+	}
+}
+
+static void can_update(unsigned long long now) {
+	SimCanFrame frame;
+	int i, best;
+
+	// Mode changes take effect at once
+	C1CTRLbits.OPMODE = C1CTRLbits.REQOP;
+	if (C1CTRLbits.OPMODE != 0) {
+		can_tx = -1;
+		return;
+	}
+
+	if (can_bus) can_bus->poll();
+	while (1) {
+		// End of the frame on the bus, told by the bus process if there is one
+		if (can_tx >= 0) {
+			if (can_bus || now < can_tx_done) break;
+			can_free = can_tx_done;
+			can_sent_ok();
+		}
+		// Next buffer: highest TXPRI, then lowest number
+		best = -1;
+		for (i = 0; i < 3; i++)
+			if (CAN_TX(i)->con.b.TXREQ &&
+				(best < 0 || CAN_TX(i)->con.b.TXPRI > CAN_TX(best)->con.b.TXPRI)) best = i;
+		if (best < 0) break;
+		can_tx = best;
+		if (can_bus) {
+			can_load(best, &frame);
+			can_bus->send(&frame);
+		} else {
+			// Requested while the bus was busy, or since the last update
+			can_tx_done = ((can_free > tick_cycles) ? can_free : now) + can_frame(CAN_TX(best)->dlc.b.DLC);
+		}
+	}
+}
+
+/* Copies a frame into rx buffer n, the flags say if there was room
+ */
+static unsigned char can_store(int n, const SimCanFrame *frame) {
+	volatile sim_CANRX_t *rx = &sim_C1RX[n];
+
+	if (rx->con.b.RXFUL) return 0;
+	rx->sid.b.SID = frame->id;
+	rx->dlc.b.DLC = frame->dlc;
+	memcpy((void *)rx->data, frame->data, sizeof(frame->data));
+	rx->con.b.RXFUL = 1;
+	C1INTF |= 1 << n;						// RX0IF-RX1IF
+	can_raise();
+	can_received++;
+	return 1;
+}
+
+static unsigned char can_match(unsigned int id, int mask, int first, int last) {
+	unsigned int m = sim_C1RXM[mask].b.SID;
+	int i;
+
+	for (i = first; i <= last; i++)
+		if (((id ^ sim_C1RXF[i].b.SID) & m) == 0) return 1;
+	return 0;
+}
+
+unsigned char SimCanDeliver(const SimCanFrame *frame) {
+	if (C1CTRLbits.OPMODE != 0) return 0;
+	if (can_match(frame->id, 0, 0, 1)) {
+		if (can_store(0, frame)) return 1;
+		// Buffer 0 full: into buffer 1 if double buffering is on
+		if (sim_C1RX[0].con.b.DBEN && can_store(1, frame)) return 1;
+		C1INTFbits.RX0OVR = 1;
+		can_lost++;
+		can_raise();
+	} else if (can_match(frame->id, 1, 2, 5)) {
+		if (can_store(1, frame)) return 1;
+		C1INTFbits.RX1OVR = 1;
+		can_lost++;
+		can_raise();
+	}
+	return 0;
+}
+
+void SimCanAttach(const SimCanBus *bus) {
+	can_bus = bus;
+}
+
+/******************************************************************************/
+/* Interrupts                                                                 */
+/******************************************************************************/
+/* Returns the handler of a source if its interrupt is pending
+ */
+static void (*pending(int vec))(void) {
+	switch (vec) {
+		case VEC_T1:	return (IFS0bits.T1IF && IEC0bits.T1IE) ? _T1Interrupt : 0;
+		case VEC_T2:	return (IFS0bits.T2IF && IEC0bits.T2IE) ? _T2Interrupt : 0;
+		case VEC_T3:	return (IFS0bits.T3IF && IEC0bits.T3IE) ? _T3Interrupt : 0;
+		case VEC_U1RX:	return (IFS0bits.U1RXIF && IEC0bits.U1RXIE) ? _U1RXInterrupt : 0;
+		case VEC_U1TX:	return (IFS0bits.U1TXIF && IEC0bits.U1TXIE) ? _U1TXInterrupt : 0;
+		case VEC_ADC:	return (IFS0bits.ADIF && IEC0bits.ADIE) ? _ADCInterrupt : 0;
+		case VEC_C1:	return (IFS1bits.C1IF && IEC1bits.C1IE) ? _C1Interrupt : 0;
+	}
+	return 0;
+}
+
+static unsigned char any_pending() {
+	int vec;
+
+	for (vec = 0; vec < VECTORS; vec++) if (pending(vec)) return 1;
+	return 0;
+}
+
+/* Serves the pending interrupts in natural order while the CPU priority allows
+ */
+static void dispatch() {
+	void (*isr)(void);
+	unsigned long long begin, spent;
+	unsigned int ipl, served = 0;
+	int vec;
+
+	for (vec = 0; vec < VECTORS && SRbits.IPL < ISR_IPL; vec++) {
+		isr = pending(vec);
+		if (!isr) continue;
+		ipl = SRbits.IPL;
+		SRbits.IPL = ISR_IPL;
+		begin = SimCycles();
+		isr();
+		spent = SimCycles() - begin;
+		SRbits.IPL = ipl;
+		isr_count[vec]++;
+		isr_total++;
+		isr_cycles[vec] += spent;
+		if (spent > isr_max[vec]) isr_max[vec] = spent;
+		// Start over: a source earlier in the order may be pending now. A handler
+		// that doesn't clear its flag is served again at the next tick.
+		if (++served > 64) break;
+		vec = -1;
+	}
+}
+
+static void update(unsigned long long now) {
+	timers_update(now);
+	uart_update(now);
+	adc_update(now);
+	can_update(now);
+	tick_cycles = now;
+}
+
+static void tick(int sig) {
+	if (stepped && sig) {
+		// Only a node stuck waiting for a tick gets one from the alarm
+		if (++stalls < SIM_STALLS) return;
+		stalls = 0;
+		step_time = tick_cycles + TICK_CYCLES;
+	}
+	SimLock();
+	update(SimCycles());
+	dispatch();
+	held = any_pending();
+	uart_flush();
+	SimUnlock();
+}
+
+void sim_ipl_lowered() {
+	step();
+	// Only after a tick found the priority raised: this runs at every IRQ_RESTORE
+	if (!held || SRbits.IPL >= ISR_IPL) return;
+	SimLock();
+	held = 0;
+	dispatch();
+	held = any_pending();
+	uart_flush();
+	SimUnlock();
+}
+
+void sim_preempt() {
+	step();
+	if (!preempt || SRbits.IPL >= ISR_IPL) return;
+	SimLock();
+	update(SimCycles());
+	dispatch();
+	held = any_pending();
+	uart_flush();
+	SimUnlock();
+}
+
+void sim_idle() {
+	unsigned long served = isr_total;
+	unsigned int ipl;
+
+	// Until an interrupt is served by the tick or pending behind the priority
+	while (stepped && !any_pending() && isr_total == served) advance(TICK_CYCLES);
+	SimLock();
+	while (!any_pending() && isr_total == served) sigsuspend(&lock_mask);
+	ipl = SRbits.IPL;
+	SRbits.IPL = 0;
+	dispatch();
+	SRbits.IPL = ipl;
+	uart_flush();
+	SimUnlock();
+}
+
+/* Sleeps until a deadline: a relative sleep restarted after every tick would
+ * lose the time it had slept, and hardly advance with SIM_TICK_US ticks
+ */
+void Delay5ms() {
+	struct timespec end;
+	unsigned int i;
+
+	if (getenv("SIM_NO_DELAY")) return;
+	if (stepped) {
+		for (i = 0; i < 5000 / SIM_TICK_US; i++) advance(TICK_CYCLES);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_nsec += 5000000;
+	if (end.tv_nsec >= 1000000000) {
+		end.tv_sec++;
+		end.tv_nsec -= 1000000000;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end, NULL) != 0);
+}
+
+/******************************************************************************/
+/* Start and end                                                              */
+/******************************************************************************/
+/* Prints the statistics, the handler times are host time in cycles of SIM_FCY
+ */
+static void report() {
+	int vec;
+
+	if (!stats) return;
+	fprintf(stderr, "\nsim: %.3f s\n", SimCycles() / (double)SIM_FCY);
+	fprintf(stderr, "sim: isr    count      mean cyc   max cyc\n");
+	for (vec = 0; vec < VECTORS; vec++) {
+		if (isr_count[vec] == 0) continue;
+		fprintf(stderr, "sim: %-5s %9lu %10llu %9llu\n", vec_names[vec], isr_count[vec],
+				isr_cycles[vec] / isr_count[vec], isr_max[vec]);
+	}
+	fprintf(stderr, "sim: uart %lu bytes sent, %lu received, %lu overruns\n",
+			uart_sent, uart_received, uart_overruns);
+	fprintf(stderr, "sim: can %lu frames sent, %lu received, %lu lost, %lu errors\n",
+			can_sent, can_received, can_lost, can_errors);
+}
+
+static void finish() {
+	uart_flush();
+	if (termios_saved) tcsetattr(0, TCSANOW, &saved_termios);
+	report();
+}
+
+static void terminate(int sig) {
+	finish();
+	_exit(0);
+}
+
+/* Runs before the node's main(): resets the registers and starts the tick
+ */
+__attribute__((constructor)) static void sim_start() {
+	struct itimerval timer = {{0, SIM_TICK_US}, {0, SIM_TICK_US}};
+	struct sigaction action;
+	struct termios raw;
+	const char *adc = getenv("SIM_ADC");
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	sigemptyset(&alarm_set);
+	sigaddset(&alarm_set, SIGALRM);
+	stats = getenv("SIM_STATS") != NULL;
+	preempt = getenv("SIM_PREEMPT") != NULL;
+	if (adc) adc_value = atoi(adc) & 1023;
+
+	// Reset values
+	U1STAbits.TRMT = 1;
+	C1CTRLbits.REQOP = C1CTRLbits.OPMODE = 0b100;
+
+	// Keys reach the node one by one, without echo
+	if (isatty(0) && tcgetattr(0, &saved_termios) == 0) {
+		termios_saved = 1;
+		raw = saved_termios;
+		raw.c_lflag &= ~(ICANON | ECHO);
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+		tcsetattr(0, TCSANOW, &raw);
+	}
+	atexit(finish);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = terminate;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	action.sa_handler = adc_adjust;
+	sigaction(SIGUSR1, &action, NULL);
+	sigaction(SIGUSR2, &action, NULL);
+	action.sa_handler = tick;
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGALRM, &action, NULL);
+	setitimer(ITIMER_REAL, &timer, NULL);
+}
@@ -0,0 +1,55 @@
+/* sim.h - Simulador en el PC de los periféricos del dsPIC30F4011. */
+#ifndef SIM_H
+#define SIM_H
+
+// Instruction clock of every node (7.3728 MHz crystal with PLL x16)
+#define SIM_FCY			29491200UL
+// Period of the simulation tick: peripherals are brought up to date and the
+// pending interrupts served at least this often (shorter than a UART character)
+#define SIM_TICK_US		50
+
+// A CAN frame as it goes on the bus: standard identifier and up to 4 words
+typedef struct {
+	unsigned int id;
+	unsigned int dlc;
+	unsigned int data[4];
+} SimCanFrame;
+
+// CAN bus seen by the node. send is called when the node starts transmitting a
+// frame, and the bus ends it with SimCanTxDone. poll is called on every tick in
+// normal mode, to deliver the frames of the other nodes with SimCanDeliver. Both
+// run with the simulation locked. Without a bus, the frames transmitted take
+// their time on the wire and are acknowledged and lost.
+typedef struct {
+	void (*send)(const SimCanFrame *frame);
+	void (*poll)(void);
+} SimCanBus;
+
+// Connect the node to a CAN bus, before main() (from a constructor)
+void SimCanAttach(const SimCanBus *bus);
+
+// End of the frame being sent: acknowledged, or an error frame after which the
+// node sends it again
+void SimCanTxDone(unsigned char acked);
+
+// Bit time configured in C1CFG1/C1CFG2, in picoseconds
+unsigned long SimCanBitTime(void);
+
+// Offer a frame to the rx buffers through the acceptance masks and filters,
+// as the CAN module does. Returns 1 if a buffer took it.
+unsigned char SimCanDeliver(const SimCanFrame *frame);
+
+// Cycles of the instruction clock since the node started
+unsigned long long SimCycles(void);
+
+// From now on the clock only advances with the node's calls into the simulator,
+// not with the real time, so a run with the same inputs repeats exactly (see
+// sim.c)
+void SimStepClock(void);
+
+// Keep the simulation tick from running, around code that touches the
+// simulated peripherals from main()
+void SimLock(void);
+void SimUnlock(void);
+
+#endif
@@ -0,0 +1,188 @@
+/* tearcheck.c - Prueba de estados sin cortes de los esclavos en el simulador. */
+/* Writes a capture (capture.h) of M_TRAJ frames whose every field comes from
+ * one counter, with paddle positions of both slaves in between, to be replayed
+ * into a slave at full speed:
+ *
+ *   tearcheck -w stress.cap [frames]
+ *
+ * Then reads the terminal output of the slave through the VT100 model of
+ * vt100.h and checks that every ball drawn is on a cell one of those frames
+ * gives. A ball whose x and y came from different frames is a torn copy of the
+ * game state:
+ *
+ *   tearcheck esclavo1c.out...
+ *
+ * The keys given to the slave end by taking its own paddle to the top row, and
+ * the last screen must show both paddles whole, in one run of rows each, one of
+ * them at the top: rows left behind or missing mean the screen and the state
+ * copies the slave drew it from went apart while the keys moved the paddle.
+ *
+ * Exits with 1 if a ball is off those cells, too few balls were drawn or the
+ * paddles are wrong. With
+ * -t the outputs come from a build that doesn't protect its copies, and it
+ * exits with 1 if none of them has a torn ball, as the check would then prove
+ * nothing:
+ *
+ *   tearcheck -t esclavo1c-ctl.out...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture.h"
+#include "vt100.h"
+#include "../proto.h"
+#include "../physics.h"
+
+/******************************************************************************/
+/* Constants				                                                  */
+/******************************************************************************/
+#define FRAMES		10000		// Default trajectories written
+#define BALL_CHAR	'O'			// Ball on the slave terminals
+#define BALLS_MIN	20			// Balls a slave must draw for the check to count
+#define PADDLE_CHAR	'#'			// Paddles on the slave terminals
+
+// Ball cell of trajectory n: x from 4 to 67, y from x, so that the x of one
+// frame and the y of another make a cell off the list
+#define BALL_X(n)	(4 + (n) % 64)
+#define BALL_Y(x)	((7*(x) + 1) % 24)
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+int write_capture(const char *path, unsigned long frames);
+void add(void *capture, const CANFrame *frame, unsigned long n);
+int check_output(const char *path, unsigned long *torn);
+int check_paddles(const char *path, const Vt100 *vt);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+int main(int argc, char *argv[]) {
+	unsigned long torn, torn_total = 0;
+	int i, first = 1, control = 0, failed = 0;
+
+	if (argc > 2 && strcmp(argv[1], "-w") == 0) {
+		return write_capture(argv[2], (argc > 3) ? strtoul(argv[3], NULL, 10) : FRAMES);
+	}
+	if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+		control = 1;
+		first = 2;
+	}
+	if (argc <= first) {
+		fprintf(stderr, "usage: tearcheck -w capture [frames] | tearcheck [-t] output...\n");
+		return 2;
+	}
+	for (i = first; i < argc; i++) {
+		failed |= check_output(argv[i], &torn);
+		torn_total += torn;
+	}
+	if (control) {
+		if (torn_total > 0) return 0;
+		printf("FAIL: no torn ball in the control build, the check proves nothing\n");
+		return 1;
+	}
+	return failed;
+}
+
+/* Writes the trajectories, each followed by a position of both paddles
+ */
+int write_capture(const char *path, unsigned long frames) {
+	void *capture = CaptureCreate(path, 0);
+	CANFrame frame;
+	unsigned long n;
+	unsigned int x;
+
+	if (!capture) {
+		perror(path);
+		return 1;
+	}
+	for (n = 0; n < frames; n++) {
+		x = BALL_X(n);
+		M_TRAJ_pack(&frame, TO_FIX(x), TO_FIX(BALL_Y(x)), PROTO_PAIR(0, 0), n);
+		add(capture, &frame, 3*n);
+		S1_PADDLE_pack(&frame, n % 20, n);
+		add(capture, &frame, 3*n + 1);
+		S2_PADDLE_pack(&frame, (n + 10) % 20, n);
+		add(capture, &frame, 3*n + 2);
+	}
+	CaptureClose(capture);
+	return 0;
+}
+
+/* Writes a frame as record i, a microsecond after the previous one
+ */
+void add(void *capture, const CANFrame *frame, unsigned long i) {
+	CaptureRecord record;
+	unsigned int w;
+
+	memset(&record, 0, sizeof(record));
+	record.time_ns = i * 1000ULL;
+	record.id = frame->id;
+	record.dlc = frame->dlc;
+	for (w = 0; w < 4; w++) record.data[w] = frame->data[w];
+	CaptureWrite(capture, &record);
+}
+
+/* Checks every ball drawn on the terminal output of a slave, the balls off the
+ * trajectories are counted in *torn
+ * return: 1 if one is off the trajectories or too few were drawn
+ */
+int check_output(const char *path, unsigned long *torn) {
+	static Vt100 vt;
+	unsigned long balls = 0;
+	unsigned int x, y;
+	int c;
+	FILE *file = fopen(path, "rb");
+
+	*torn = 0;
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+	Vt100Reset(&vt);
+	while ((c = getc(file)) != EOF) {
+		if (!Vt100Put(&vt, c) || c != BALL_CHAR) continue;
+		balls++;
+		x = vt.last_x;
+		y = vt.last_y;
+		if (x >= BALL_X(0) && x <= BALL_X(63) && y == BALL_Y(x)) continue;
+		if ((*torn)++ < 10) printf("%s: ball %lu at %u,%u\n", path, balls, x, y);
+	}
+	fclose(file);
+	printf("%s: %lu balls, %lu torn, %lu bytes, %lu errors\n", path, balls, *torn,
+		   vt.bytes, vt.errors);
+	return *torn > 0 || balls < BALLS_MIN || vt.errors > 0 || check_paddles(path, &vt);
+}
+
+/* Checks the paddles on the last screen of a slave
+ * return: 1 if one isn't a single run of PADDLE_L rows, or none is at the top
+ */
+int check_paddles(const char *path, const Vt100 *vt) {
+	static const unsigned int columns[2] = {PAD1_X, PAD2_X};
+	unsigned int i, x, y, rows, top = 0, last = 0, at_top = 0;
+	int failed = 0;
+
+	for (i = 0; i < 2; i++) {
+		for (x = columns[i]; x < columns[i] + PADDLE_W; x++) {
+			rows = 0;
+			top = VT100_ROWS;
+			for (y = 0; y < VT100_ROWS; y++) {
+				if (vt->cell[y][x] != PADDLE_CHAR) continue;
+				if (rows == 0) top = y;
+				last = y;
+				rows++;
+			}
+			if (rows != PADDLE_L || last - top + 1 != rows) {
+				printf("%s: paddle %u, column %u: %u rows from row %u\n", path, i + 1, x,
+					   rows, top);
+				failed = 1;
+			}
+		}
+		if (top == 0) at_top = 1;
+	}
+	if (!failed && !at_top) {
+		printf("%s: no paddle at the top row\n", path);
+		failed = 1;
+	}
+	return failed;
+}
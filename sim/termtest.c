@@ -0,0 +1,246 @@
+/* termtest.c - Prueba de term.c y screen.c contra el modelo de vt100.h. */
+/* Feeds the bytes term.c sends to a VT100 model, in two parts:
+ *  - term.c: runs of random characters, mostly near the cursor so every kind
+ *    of move gets chosen. The cells the planner may overwrite to move change
+ *    at random. Every character must land on its cell, and the whole screen
+ *    must match the one written.
+ *  - screen.c: random cell, fill, sprite and clear operations, flushed with
+ *    random budgets. A flush may only go over its budget by one cell, and the
+ *    terminal must show the cells and the sprite once nothing is left dirty.
+ *
+ *   termtest [writes [operations]]
+ *
+ * Prints the bytes sent and saved, and exits with 1 at the first mismatch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "vt100.h"
+#include "../term.h"
+#include "../screen.h"
+
+/******************************************************************************/
+/* Constants				                                                  */
+/******************************************************************************/
+#define WRITES		2000000		// Default characters written
+#define CLEAR_ODDS	50000		// One clear every this many runs
+#define RUN_MAX		4			// Characters written after each move
+#define OPERATIONS	1000000		// Default screen.c operations
+#define BUDGET_MAX	200			// Flush budgets of 1 to BUDGET_MAX bytes
+#define CELL_MAX	9			// Bytes of a cell at most: ESC[row;colH and its character
+#define CELL_CHARS	" #O?"
+
+/******************************************************************************/
+/* Global Variable declaration                                                */
+/******************************************************************************/
+// Terminal fed by term.c
+Vt100 vt;
+// Characters written, and cells the reader tells term.c about
+unsigned char screen[TERM_ROWS][TERM_COLS];
+unsigned char known[TERM_ROWS][TERM_COLS];
+// Cells and sprite given to screen.c
+unsigned char cells[SCREEN_ROWS][SCREEN_COLS];
+unsigned int sprite_x = SCREEN_COLS, sprite_y;
+unsigned char sprite_cell;
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+int term_test(unsigned long writes);
+int screen_test(unsigned long operations);
+unsigned char reader(unsigned int x, unsigned int y);
+void clear(void);
+unsigned int near(unsigned int from, unsigned int range, unsigned int size);
+int check_screen(const char *part, unsigned long done);
+void set(unsigned int x, unsigned int y, unsigned char cell);
+void shown(void);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+int main(int argc, char *argv[]) {
+	unsigned long writes = (argc > 1) ? strtoul(argv[1], NULL, 10) : WRITES;
+	unsigned long operations = (argc > 2) ? strtoul(argv[2], NULL, 10) : OPERATIONS;
+
+	srand(1);
+	Vt100Reset(&vt);
+	if (term_test(writes)) return 1;
+	if (screen_test(operations)) return 1;
+	if (vt.bytes != TermBytes() || vt.errors || vt.scrolls) {
+		printf("term: %lu bytes received of %lu, %lu errors, %lu scrolls\n",
+			   vt.bytes, TermBytes(), vt.errors, vt.scrolls);
+		return 1;
+	}
+	return 0;
+}
+
+/* Writes random characters straight through term.c
+ * return: 1 at the first mismatch
+ */
+int term_test(unsigned long writes) {
+	unsigned long done = 0;
+	unsigned int x = 0, y = 0, len, i;
+	unsigned char c;
+
+	TermSetCellReader(reader);
+	clear();
+	while (done < writes) {
+		if (rand() % CLEAR_ODDS == 0) clear();
+		for (i = 0; i < 4; i++) known[rand() % TERM_ROWS][rand() % TERM_COLS] ^= 1;
+
+		// Anywhere once every 4 runs, near the cursor otherwise
+		if (rand() % 4 == 0) {
+			x = rand() % TERM_COLS;
+			y = rand() % TERM_ROWS;
+		} else {
+			x = near(x, 3, TERM_COLS);
+			y = near(y, 2, TERM_ROWS);
+		}
+		len = 1 + rand() % RUN_MAX;
+		if (x + len > TERM_COLS) len = TERM_COLS - x;
+
+		TermGoto(x, y);
+		for (i = 0; i < len; i++, x++, done++) {
+			c = ' ' + rand() % 95;
+			TermPutc(c);
+			screen[y][x] = c;
+			if (vt.cell[y][x] != c) {
+				printf("term: write %lu at %u,%u: '%c' on the terminal, '%c' written\n",
+					   done, x, y, vt.cell[y][x], c);
+				return 1;
+			}
+		}
+		if (x == TERM_COLS) x--;
+		if (done % 1000 < len && check_screen("term", done)) return 1;
+	}
+	if (check_screen("term", done)) return 1;
+	printf("term: %lu writes, %lu bytes, %lu saved\n", done, TermBytes(), TermSaved());
+	return 0;
+}
+
+/* Changes the screen.c cells at random, mostly near the last change, and
+ * flushes them with random budgets
+ * return: 1 at the first mismatch
+ */
+int screen_test(unsigned long operations) {
+	unsigned long done, bytes = TermBytes(), saved = TermSaved(), start;
+	unsigned int x = 0, y = 0, w, h, i, j, budget, flushes = 0;
+	unsigned char cell;
+
+	ScreenInit(CELL_CHARS);
+	for (y = 0; y < SCREEN_ROWS; y++) {
+		for (x = 0; x < SCREEN_COLS; x++) cells[y][x] = SCREEN_BLANK;
+	}
+	for (done = 0; done < operations; done++) {
+		x = near(x, 4, SCREEN_COLS + 2);
+		y = near(y, 3, SCREEN_ROWS + 2);
+		cell = rand() % 4;
+		switch (rand() % 10) {
+			case 0: case 1: case 2: case 3:
+				ScreenSet(x, y, cell);
+				set(x, y, cell);
+				break;
+			case 4:
+				w = rand() % 6;
+				h = rand() % 4;
+				ScreenFill(x, y, w, h, cell);
+				for (i = y; i < y + h; i++) {
+					for (j = x; j < x + w; j++) set(j, i, cell);
+				}
+				break;
+			case 5: case 6:
+				ScreenSprite(x, y, cell);
+				sprite_x = (x < SCREEN_COLS && y < SCREEN_ROWS) ? x : SCREEN_COLS;
+				sprite_y = y;
+				sprite_cell = cell;
+				break;
+			default:
+				if (rand() % 5000 == 0) {
+					ScreenClear();
+					for (i = 0; i < SCREEN_ROWS; i++) {
+						for (j = 0; j < SCREEN_COLS; j++) cells[i][j] = SCREEN_BLANK;
+					}
+				}
+				budget = (rand() % 4 == 0) ? SCREEN_NO_LIMIT : 1 + rand() % BUDGET_MAX;
+				start = TermBytes();
+				ScreenFlush(budget);
+				flushes++;
+				if (TermBytes() - start >= budget + CELL_MAX) {
+					printf("screen: flush %u sent %lu bytes for a budget of %u\n",
+						   flushes, TermBytes() - start, budget);
+					return 1;
+				}
+				if (ScreenDirty() > 0) break;
+				shown();
+				if (check_screen("screen", done)) return 1;
+		}
+	}
+	ScreenFlush(SCREEN_NO_LIMIT);
+	shown();
+	if (check_screen("screen", done)) return 1;
+	printf("screen: %lu operations, %u flushes, %lu bytes, %lu saved\n", done, flushes,
+		   TermBytes() - bytes, TermSaved() - saved);
+	return 0;
+}
+
+void UartTxPut(unsigned char c) {
+	Vt100Put(&vt, c);
+}
+
+unsigned char reader(unsigned int x, unsigned int y) {
+	if (x >= TERM_COLS || y >= TERM_ROWS || !known[y][x]) return 0;
+	return screen[y][x];
+}
+
+void clear() {
+	unsigned int x, y;
+
+	TermClear();
+	for (y = 0; y < TERM_ROWS; y++) {
+		for (x = 0; x < TERM_COLS; x++) screen[y][x] = ' ';
+	}
+}
+
+/* Returns a coordinate up to range cells away from 'from', inside 0-size-1
+ */
+unsigned int near(unsigned int from, unsigned int range, unsigned int size) {
+	int n = (int)from + rand() % (2*range + 1) - (int)range;
+
+	if (n < 0) return 0;
+	if (n >= (int)size) return size - 1;
+	return n;
+}
+
+/* Records a cell given to ScreenSet, which ignores the ones outside the screen
+ */
+void set(unsigned int x, unsigned int y, unsigned char cell) {
+	if (x < SCREEN_COLS && y < SCREEN_ROWS) cells[y][x] = cell;
+}
+
+/* Leaves in screen the characters the cells and the sprite must show
+ */
+void shown() {
+	unsigned int x, y;
+
+	for (y = 0; y < SCREEN_ROWS; y++) {
+		for (x = 0; x < SCREEN_COLS; x++) screen[y][x] = CELL_CHARS[cells[y][x]];
+	}
+	if (sprite_x < SCREEN_COLS) screen[sprite_y][sprite_x] = CELL_CHARS[sprite_cell];
+}
+
+/* Compares the whole terminal with the characters written, after 'done' writes
+ * or operations of a part of the test
+ * return: 1 if they differ
+ */
+int check_screen(const char *part, unsigned long done) {
+	unsigned int x, y;
+
+	for (y = 0; y < TERM_ROWS; y++) {
+		for (x = 0; x < TERM_COLS; x++) {
+			if (vt.cell[y][x] == screen[y][x]) continue;
+			printf("%s: after %lu %u,%u is '%c' on the terminal, '%c' written\n",
+				   part, done, x, y, vt.cell[y][x], screen[y][x]);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,201 @@
+/* tracedec.c - Decodificador de los volcados de trace.h a una línea de tiempo. */
+/* Reads the dumps a node writes to its UART (the terminal output of a slave:
+ * "@TRACE" sections) or sends over the CAN (TRACE_DUMP frames in a capture of
+ * canbusd -w), and prints every dump as a timeline: time since its first event,
+ * time since the previous one, event and argument. The PROF_DUMP frames of a
+ * capture (prof.h) are printed as a table per node, and so are its STATS_DUMP
+ * frames (stats.h).
+ *
+ *   tracedec [-f fcy] file...
+ *
+ * The times of the nodes come from their own clocks, so every dump has its own
+ * timeline. fcy is the instruction clock of the nodes (default SIM_FCY).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "capture.h"
+#include "../proto.h"
+#include "../trace.h"
+#include "../prof.h"
+#include "../stats.h"
+
+/******************************************************************************/
+/* Global Variable declaration                                                */
+/******************************************************************************/
+#define TRACE_NAME(id, name, arg)	name,
+#define TRACE_ARG(id, name, arg)	arg,
+const char *const names[TRACE_COUNT] = { TRACE_EVENTS(TRACE_NAME) };
+const char *const args[TRACE_COUNT] = { TRACE_EVENTS(TRACE_ARG) };
+#define PROF_NAME(id, name)			name,
+const char *const points[PROF_COUNT] = { PROF_POINTS(PROF_NAME) };
+#define STATS_NAME(id, name)		name,
+const char *const counter_names[STATS_COUNT] = { STATS_COUNTERS(STATS_NAME) };
+
+double fcy = SIM_FCY;
+
+// Dump being printed
+int dump_node = -1;
+unsigned long dump_events;
+unsigned long long dump_first, dump_prev, dump_time;
+
+/******************************************************************************/
+/* Prototypes                                                                 */
+/******************************************************************************/
+void begin_dump(int node);
+void end_dump();
+void event(unsigned long time, unsigned int id, unsigned int arg);
+void profile(const CaptureRecord *r, unsigned long count);
+void counters(const CaptureRecord *r, unsigned long count);
+int decode_capture(const char *path);
+int decode_text(const char *path);
+
+/******************************************************************************/
+/* Procedures                                                                 */
+/******************************************************************************/
+int main(int argc, char *argv[]) {
+	int opt, i, status = 0;
+
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+			case 'f': fcy = strtod(optarg, NULL); break;
+			default:
+				fprintf(stderr, "usage: %s [-f fcy] file...\n", argv[0]);
+				return 2;
+		}
+	}
+	for (i = optind; i < argc; i++) {
+		if (decode_capture(argv[i]) < 0 && decode_text(argv[i]) < 0) {
+			perror(argv[i]);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+void begin_dump(int node) {
+	end_dump();
+	dump_node = node;
+	dump_events = 0;
+	printf("node %d\n%14s %12s  %-12s %s\n", node, "ms", "+us", "event", "arg");
+}
+
+void end_dump() {
+	if (dump_node < 0) return;
+	printf("node %d: %lu events in %.3f ms\n\n", dump_node, dump_events,
+		   (dump_time - dump_first) * 1e3 / fcy);
+	dump_node = -1;
+}
+
+/* Prints an event of the dump, its 32-bit time unwrapped against the previous
+ * one (the events of a dump are in order)
+ */
+void event(unsigned long time, unsigned int id, unsigned int arg) {
+	if (dump_events == 0) {
+		dump_first = dump_prev = dump_time = time;
+	} else {
+		dump_prev = dump_time;
+		dump_time += (uint32_t)(time - dump_time);
+	}
+	dump_events++;
+	printf("%14.6f %12.3f  %-12s 0x%04x", (dump_time - dump_first) * 1e3 / fcy,
+		   (dump_time - dump_prev) * 1e6 / fcy,
+		   (id < TRACE_COUNT) ? names[id] : "?", arg);
+	if (id < TRACE_COUNT && *args[id]) printf("  %s", args[id]);
+	printf("\n");
+}
+
+/* TRACE_DUMP frames of a capture. A new dump starts when the node changes or
+ * its time goes back (a later dump of the same node).
+ */
+int decode_capture(const char *path) {
+	const CaptureRecord *r;
+	unsigned long count, i, time, last = 0;
+	int node;
+
+	r = CaptureMap(path, &count, NULL);
+	if (!r) return -1;
+	for (i = 0; i < count; i++, r++) {
+		if (r->id != TRACE_DUMP || (r->flags & CAPTURE_ERROR)) continue;
+		node = PROTO_HI(r->data[TRACE_DUMP_event_W]);
+		time = r->data[TRACE_DUMP_time_lo_W] | ((unsigned long)r->data[TRACE_DUMP_time_hi_W] << 16);
+		if (node != dump_node || time < last) begin_dump(node);
+		last = time;
+		event(time, PROTO_LO(r->data[TRACE_DUMP_event_W]), r->data[TRACE_DUMP_arg_W]);
+	}
+	end_dump();
+	profile(r - count, count);
+	counters(r - count, count);
+	return 0;
+}
+
+/* PROF_DUMP frames of a capture, a table for every answer of a node (its
+ * points come in order, so a point not above the previous one starts another)
+ */
+void profile(const CaptureRecord *r, unsigned long count) {
+	unsigned long i;
+	unsigned int node, point;
+	int last_node = -1, last_point = -1;
+
+	for (i = 0; i < count; i++, r++) {
+		if (r->id != PROF_DUMP || (r->flags & CAPTURE_ERROR)) continue;
+		node = PROTO_HI(r->data[PROF_DUMP_point_W]);
+		point = PROTO_LO(r->data[PROF_DUMP_point_W]);
+		if ((int)node != last_node || (int)point <= last_point) {
+			printf("node %u profile\n%-16s %8s %8s %8s %10s\n", node, "point", "count",
+				   "avg", "max", "avg us");
+		}
+		last_node = node;
+		last_point = point;
+		printf("%-16s %8u %8u %8u %10.3f\n", (point < PROF_COUNT) ? points[point] : "?",
+			   r->data[PROF_DUMP_count_W], r->data[PROF_DUMP_avg_W],
+			   r->data[PROF_DUMP_max_W], r->data[PROF_DUMP_avg_W] * 1e6 / fcy);
+	}
+}
+
+/* STATS_DUMP frames of a capture, a table for every answer of a node (its
+ * counters come in order, so a counter not above the previous one starts another)
+ */
+void counters(const CaptureRecord *r, unsigned long count) {
+	unsigned long i;
+	unsigned int node, counter;
+	int last_node = -1, last_counter = -1;
+
+	for (i = 0; i < count; i++, r++) {
+		if (r->id != STATS_DUMP || (r->flags & CAPTURE_ERROR)) continue;
+		node = PROTO_HI(r->data[STATS_DUMP_counter_W]);
+		counter = PROTO_LO(r->data[STATS_DUMP_counter_W]);
+		if ((int)node != last_node || (int)counter <= last_counter) {
+			printf("node %u counters\n%-16s %10s\n", node, "counter", "value");
+		}
+		last_node = node;
+		last_counter = counter;
+		printf("%-16s %10lu\n", (counter < STATS_COUNT) ? counter_names[counter] : "?",
+			   r->data[STATS_DUMP_value_lo_W] | ((unsigned long)r->data[STATS_DUMP_value_hi_W] << 16));
+	}
+}
+
+/* "@TRACE node count" sections in a text stream, with anything around them
+ */
+int decode_text(const char *path) {
+	FILE *file = fopen(path, "rb");
+	char line[256], *at;
+	unsigned int node, count, id, arg;
+	unsigned long time;
+
+	if (!file) return -1;
+	while (fgets(line, sizeof(line), file)) {
+		if ((at = strstr(line, "@TRACE ")) && sscanf(at, "@TRACE %x %x", &node, &count) == 2) {
+			begin_dump(node);
+		} else if (strstr(line, "@END")) {
+			end_dump();
+		} else if (dump_node >= 0 && sscanf(line, "%lx %x %x", &time, &id, &arg) == 3) {
+			event(time, id, arg);
+		}
+	}
+	end_dump();
+	fclose(file);
+	return 0;
+}
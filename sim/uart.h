@@ -0,0 +1,20 @@
+/* uart.h - Sustituto en el PC de la librería de la UART de Microchip. */
+#ifndef __UART_H
+#define __UART_H
+
+#define UART_EN				0xFFFF
+#define UART_DIS_LOOPBACK	0xFFBF
+#define UART_NO_PAR_8BIT	0xFFF9
+#define UART_1STOPBIT		0xFFFE
+#define UART_TX_PIN_NORMAL	0xF7FF
+#define UART_TX_ENABLE		0xFFFF
+
+void OpenUART1(unsigned int config1, unsigned int config2, unsigned int ubrg);
+void CloseUART1(void);
+void WriteUART1(unsigned int data);
+unsigned int ReadUART1(void);
+char BusyUART1(void);
+char DataRdyUART1(void);
+void putsUART1(unsigned int *buffer);
+
+#endif
@@ -0,0 +1,128 @@
+/* vt100.c - Implementación del modelo de vt100.h. */
+#include <string.h>
+#include "vt100.h"
+
+#define ESC				27
+
+enum { NORMAL, ESCAPE, CSI };
+
+void Vt100Reset(Vt100 *t) {
+	memset(t, 0, sizeof(*t));
+	memset(t->cell, ' ', sizeof(t->cell));
+}
+
+/* Cursor down one row, scrolling up at the last one
+ */
+static void line_feed(Vt100 *t) {
+	if (t->y < VT100_ROWS - 1) {
+		t->y++;
+		return;
+	}
+	memmove(t->cell[0], t->cell[1], (VT100_ROWS - 1) * VT100_COLS);
+	memset(t->cell[VT100_ROWS - 1], ' ', VT100_COLS);
+	t->scrolls++;
+}
+
+static void print(Vt100 *t, unsigned char c) {
+	if (t->wrap) {
+		t->x = 0;
+		line_feed(t);
+		t->wrap = 0;
+	}
+	t->cell[t->y][t->x] = c;
+	t->last_x = t->x;
+	t->last_y = t->y;
+	// The cursor stays on the last column until the next character
+	if (t->x < VT100_COLS - 1) t->x++;
+	else t->wrap = 1;
+}
+
+/* Ends ESC [ params cmd, where a missing or 0 parameter is 1
+ */
+static void csi(Vt100 *t, unsigned char cmd) {
+	unsigned int n = (t->params > 0 && t->param[0] > 0) ? t->param[0] : 1;
+	unsigned int m = (t->params > 1 && t->param[1] > 0) ? t->param[1] : 1;
+
+	t->wrap = 0;
+	switch (cmd) {
+		case 'A':
+			t->y = (n > t->y) ? 0 : t->y - n;
+			break;
+		case 'B':
+			t->y = (t->y + n >= VT100_ROWS) ? VT100_ROWS - 1 : t->y + n;
+			break;
+		case 'C':
+			t->x = (t->x + n >= VT100_COLS) ? VT100_COLS - 1 : t->x + n;
+			break;
+		case 'D':
+			t->x = (n > t->x) ? 0 : t->x - n;
+			break;
+		case 'H':
+			t->y = (n > VT100_ROWS) ? VT100_ROWS - 1 : n - 1;
+			t->x = (m > VT100_COLS) ? VT100_COLS - 1 : m - 1;
+			break;
+		default:
+			t->errors++;
+	}
+}
+
+unsigned char Vt100Put(Vt100 *t, unsigned char c) {
+	t->bytes++;
+	switch (t->state) {
+		case ESCAPE:
+			if (c == '[') {
+				t->state = CSI;
+				t->param[0] = t->param[1] = 0;
+				t->params = 0;
+			} else {
+				t->state = NORMAL;
+				t->errors++;
+			}
+			return 0;
+		case CSI:
+			if (c >= '0' && c <= '9') {
+				if (t->params == 0) t->params = 1;
+				if (t->params <= 2) t->param[t->params - 1] = t->param[t->params - 1]*10 + c - '0';
+			} else if (c == ';') {
+				if (t->params == 0) t->params = 1;
+				t->params++;
+			} else {
+				t->state = NORMAL;
+				csi(t, c);
+			}
+			return 0;
+	}
+
+	if (c >= ' ' && c < 127) {
+		print(t, c);
+		return 1;
+	}
+	switch (c) {
+		case ESC:
+			t->state = ESCAPE;
+			break;
+		case '\r':
+			t->x = 0;
+			t->wrap = 0;
+			break;
+		case '\n':
+			line_feed(t);
+			t->wrap = 0;
+			break;
+		case '\b':
+			if (t->x > 0) t->x--;
+			t->wrap = 0;
+			break;
+		case 7:
+			t->bells++;
+			break;
+		case 12:
+			memset(t->cell, ' ', sizeof(t->cell));
+			t->x = t->y = 0;
+			t->wrap = 0;
+			break;
+		default:
+			t->errors++;
+	}
+	return 0;
+}
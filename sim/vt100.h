@@ -0,0 +1,27 @@
+/* vt100.h - Modelo del terminal VT100 que reciben los esclavos. */
+#ifndef VT100_H
+#define VT100_H
+
+#define VT100_COLS		80
+#define VT100_ROWS		24
+
+// Screen and cursor of a terminal fed with the bytes a slave sends. It knows
+// what term.c sends: printable characters, CR, LF, backspace, BEL, form feed
+// (clear the screen, cursor to 0,0), ESC[nA/B/C/D and ESC[row;colH. Anything
+// else is counted as an error and ignored.
+typedef struct {
+	unsigned char cell[VT100_ROWS][VT100_COLS];
+	unsigned int x, y;					// Cursor
+	unsigned int last_x, last_y;		// Cell of the last character printed
+	unsigned char wrap;					// Last column written, the next character wraps
+	unsigned char state;				// Escape sequence being received
+	unsigned int param[2], params;
+	unsigned long bytes, errors, bells, scrolls;
+} Vt100;
+
+// Blank screen with the cursor at 0,0
+void Vt100Reset(Vt100 *t);
+// Receive a byte. Returns 1 if it was printed, at last_x, last_y.
+unsigned char Vt100Put(Vt100 *t, unsigned char c);
+
+#endif
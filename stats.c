@@ -0,0 +1,14 @@
+/* stats.c - Implementación de las funciones de stats.h. */
+#include "stats.h"
+#include "proto.h"
+
+#define STATS_NAME(id, name)	name,
+static const char *const names[STATS_COUNT] = { STATS_COUNTERS(STATS_NAME) };
+
+const char *StatsName(unsigned char counter) {
+	return (counter < STATS_COUNT) ? names[counter] : "?";
+}
+
+void StatsSendCan(unsigned char node, unsigned char counter, unsigned long value) {
+	PROTO_SEND(STATS_DUMP, PROTO_PAIR(counter, node), value & 0xFFFF, value >> 16);
+}
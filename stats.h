@@ -0,0 +1,39 @@
+/* stats.h - Contadores de los nodos y su envío por el CAN. */
+#ifndef STATS_H
+#define STATS_H
+
+// Counters a node reports: X(identifier, name in the reports). Times are in
+// instruction cycles.
+#define STATS_COUNTERS(X) \
+	X(ST_SCHED_TICKS,		"sched ticks") \
+	X(ST_SCHED_OVERRUNS,	"sched overruns") \
+	X(ST_JITTER_MIN,		"jitter min cyc") \
+	X(ST_JITTER_AVG,		"jitter avg cyc") \
+	X(ST_JITTER_MAX,		"jitter max cyc") \
+	X(ST_FRAMES_DRAWN,		"frames drawn") \
+	X(ST_FRAMES_DROPPED,	"frames dropped") \
+	X(ST_FRAMES_COALESCED,	"changes merged") \
+	X(ST_FRAME_BYTES,		"bytes/frame") \
+	X(ST_FRAME_SAVED,		"saved/frame") \
+	X(ST_C1_ISR_MAX,		"C1 isr max cyc") \
+	X(ST_U1RX_ISR_MAX,		"U1RX max cyc") \
+	X(ST_U1RX_OVERRUNS,		"U1RX overruns") \
+	X(ST_CAN_RX_OVERFLOWS,	"CAN rx overflows") \
+	X(ST_CAN_RX_DROPPED,	"CAN rx dropped") \
+	X(ST_CAN_TX_HIGH,		"CAN tx high") \
+	X(ST_CAN_TX_DROPPED,	"CAN tx dropped") \
+	X(ST_UART_TX_HIGH,		"UART tx high") \
+	X(ST_UART_TX_STALLS,	"UART tx stalls") \
+	X(ST_EVQ_HIGH,			"events high") \
+	X(ST_EVQ_LOST,			"events lost")
+
+#define STATS_ID(id, name)	id,
+enum { STATS_COUNTERS(STATS_ID) STATS_COUNT };
+
+// Name of a counter, "?" if it isn't one
+const char *StatsName(unsigned char counter);
+
+// Send the value of a counter of a node as a STATS_DUMP frame
+void StatsSendCan(unsigned char node, unsigned char counter, unsigned long value);
+
+#endif
@@ -0,0 +1,241 @@
+/* term.c - Implementación de las funciones de term.h. */
+#include "term.h"
+#include "uarttx.h"
+
+#define ESC				27
+#define UNKNOWN			0xFFFF		// Cursor position after writing the last column
+
+// Horizontal move
+enum { H_NONE, H_CSI, H_BACKSPACE, H_OVERWRITE };
+// Vertical move
+enum { V_NONE, V_CSI, V_LF };
+
+// Cursor on the terminal and cursor wanted for the next character
+static unsigned int cur_x = UNKNOWN, cur_y = UNKNOWN;
+static unsigned int want_x, want_y;
+static TermCellReader cell_reader;
+// Statistics
+static unsigned long bytes, saved;
+
+static void put(unsigned char c) {
+	UartTxPut(c);
+	bytes++;
+}
+
+static unsigned int digits(unsigned int n) {
+	return (n >= 100) ? 3 : (n >= 10) ? 2 : 1;
+}
+
+static void put_number(unsigned int n) {
+	if (n >= 100) put('0' + n/100);
+	if (n >= 10) put('0' + (n/10) % 10);
+	put('0' + n % 10);
+}
+
+/* Cost of ESC [ n cmd, where n is omitted when it is 1
+ */
+static unsigned int csi_cost(unsigned int n) {
+	return (n == 1) ? 3 : 3 + digits(n);
+}
+
+static void put_csi(unsigned int n, unsigned char cmd) {
+	put(ESC);
+	put('[');
+	if (n != 1) put_number(n);
+	put(cmd);
+}
+
+/* Checks whether the characters of the cells from-to-1 of row y are known
+ */
+static unsigned char can_overwrite(unsigned int from, unsigned int to, unsigned int y) {
+	unsigned int x;
+
+	if (!cell_reader) return 0;
+	for (x = from; x < to; x++) {
+		if (cell_reader(x, y) == 0) return 0;
+	}
+	return 1;
+}
+
+/* Chooses how to move the cursor from column 'from' to 'to' on row y
+ * return: bytes needed
+ */
+static unsigned int horizontal_cost(unsigned int from, unsigned int to, unsigned int y,
+									unsigned char *how) {
+	unsigned int n, cost;
+
+	if (to == from) {
+		*how = H_NONE;
+		return 0;
+	}
+	*how = H_CSI;
+	if (to > from) {
+		n = to - from;
+		cost = csi_cost(n);
+		if (n < cost && can_overwrite(from, to, y)) {
+			*how = H_OVERWRITE;
+			cost = n;
+		}
+	} else {
+		n = from - to;
+		cost = csi_cost(n);
+		if (n < cost) {
+			*how = H_BACKSPACE;
+			cost = n;
+		}
+	}
+	return cost;
+}
+
+static void horizontal_move(unsigned int from, unsigned int to, unsigned int y, unsigned char how) {
+	unsigned int x;
+
+	switch (how) {
+		case H_CSI:
+			if (to > from) put_csi(to - from, 'C');
+			else put_csi(from - to, 'D');
+			break;
+		case H_BACKSPACE:
+			for (x = from; x > to; x--) put('\b');
+			break;
+		case H_OVERWRITE:
+			for (x = from; x < to; x++) put(cell_reader(x, y));
+			break;
+	}
+}
+
+/* Chooses how to move the cursor from row 'from' to 'to'
+ * return: bytes needed
+ */
+static unsigned int vertical_cost(unsigned int from, unsigned int to, unsigned char *how) {
+	unsigned int n, cost;
+
+	if (to == from) {
+		*how = V_NONE;
+		return 0;
+	}
+	*how = V_CSI;
+	if (to > from) {
+		n = to - from;
+		cost = csi_cost(n);
+		if (n < cost) {
+			*how = V_LF;
+			cost = n;
+		}
+	} else {
+		cost = csi_cost(from - to);
+	}
+	return cost;
+}
+
+static void vertical_move(unsigned int from, unsigned int to, unsigned char how) {
+	unsigned int y;
+
+	switch (how) {
+		case V_CSI:
+			if (to > from) put_csi(to - from, 'B');
+			else put_csi(from - to, 'A');
+			break;
+		case V_LF:
+			// Down on the same column: the terminal must not translate LF to CRLF
+			for (y = from; y < to; y++) put('\n');
+			break;
+	}
+}
+
+/* Moves the cursor where TermGoto placed it, with the cheapest sequence
+ */
+static void flush_move() {
+	unsigned int absolute, relative, from_cr, cost, old;
+	unsigned char v = V_NONE, h = H_NONE, h_cr = H_NONE;
+
+	if (cur_x == want_x && cur_y == want_y) return;
+
+	// ESC [ row ; col H, 1-based
+	absolute = 4 + digits(want_y + 1) + digits(want_x + 1);
+	relative = from_cr = absolute + 1;
+	old = 0;
+	if (cur_y != UNKNOWN) {
+		// Relative moves from the start of the row (CR) or from the cursor
+		from_cr = vertical_cost(cur_y, want_y, &v);
+		if (cur_x != UNKNOWN) {
+			relative = from_cr + horizontal_cost(cur_x, want_x, want_y, &h);
+			// One ESC [ A/B/C/D per cell
+			old = 3 * ((cur_x > want_x) ? cur_x - want_x : want_x - cur_x);
+			old += 3 * ((cur_y > want_y) ? cur_y - want_y : want_y - cur_y);
+		}
+		from_cr += 1 + horizontal_cost(0, want_x, want_y, &h_cr);
+	}
+
+	if (absolute <= relative && absolute <= from_cr) {
+		cost = absolute;
+		put(ESC);
+		put('[');
+		put_number(want_y + 1);
+		put(';');
+		put_number(want_x + 1);
+		put('H');
+	} else if (relative <= from_cr) {
+		cost = relative;
+		vertical_move(cur_y, want_y, v);
+		horizontal_move(cur_x, want_x, want_y, h);
+	} else {
+		cost = from_cr;
+		put('\r');
+		vertical_move(cur_y, want_y, v);
+		horizontal_move(0, want_x, want_y, h_cr);
+	}
+	if (old > cost) saved += old - cost;
+
+	cur_x = want_x;
+	cur_y = want_y;
+}
+
+void TermClear() {
+	put(12);
+	cur_x = cur_y = 0;
+	want_x = want_y = 0;
+}
+
+void TermGoto(unsigned int x, unsigned int y) {
+	want_x = x;
+	want_y = y;
+}
+
+unsigned int TermX() {
+	return want_x;
+}
+
+unsigned int TermY() {
+	return want_y;
+}
+
+void TermPutc(unsigned char c) {
+	flush_move();
+	put(c);
+	want_x++;
+	// Terminals differ on where the cursor stays after the last column: on the
+	// same row or at the start of the next one, so the next move is absolute
+	if (want_x < TERM_COLS) cur_x = want_x;
+	else cur_x = cur_y = UNKNOWN;
+}
+
+void TermPuts(const char *s) {
+	while (*s) TermPutc(*s++);
+}
+
+void TermBell(unsigned char c) {
+	put(c);
+}
+
+void TermSetCellReader(TermCellReader reader) {
+	cell_reader = reader;
+}
+
+unsigned long TermBytes() {
+	return bytes;
+}
+
+unsigned long TermSaved() {
+	return saved;
+}
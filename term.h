@@ -0,0 +1,35 @@
+/* term.h - Cursor del terminal con el movimiento más barato posible. */
+#ifndef TERM_H
+#define TERM_H
+
+// Terminal size
+#define TERM_COLS		80
+#define TERM_ROWS		24
+
+// Returns the character drawn at a cell, or 0 if it isn't known. Lets the
+// cursor move right by writing the same characters again.
+typedef unsigned char (*TermCellReader)(unsigned int x, unsigned int y);
+
+// Clear the screen (form feed), the cursor goes to 0,0
+void TermClear(void);
+// Place the cursor. Nothing is sent until the next character, then the cheapest
+// of absolute addressing, counted relative moves, CR/LF/backspace and
+// overwriting known cells is used. LF is taken as a move down on the same
+// column: the terminal must not translate it to CRLF.
+void TermGoto(unsigned int x, unsigned int y);
+// Cursor position, as placed by TermGoto and the characters written
+unsigned int TermX(void);
+unsigned int TermY(void);
+// Write a character or a string at the cursor, which advances one cell per character
+void TermPutc(unsigned char c);
+void TermPuts(const char *s);
+// Send a character that doesn't move the cursor (BEL...)
+void TermBell(unsigned char c);
+// Set the function used to know the characters on the screen (0: none)
+void TermSetCellReader(TermCellReader reader);
+
+// Statistics
+unsigned long TermBytes(void);		// Bytes sent
+unsigned long TermSaved(void);		// Bytes saved by the moves against one ESC[A/B/C/D per cell
+
+#endif
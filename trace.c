@@ -0,0 +1,73 @@
+/* trace.c - Implementación de las funciones de trace.h. */
+#include "trace.h"
+#ifdef TRACE
+#include "proto.h"
+
+TraceEntry trace_ring[TRACE_SIZE];
+unsigned int trace_head, trace_used;
+volatile unsigned char trace_frozen;
+
+static unsigned char trace_node;
+// Next entry of the CAN dump (counted from the oldest) and entries it sends
+static unsigned int dump_next, dump_count;
+
+void TraceInit(unsigned char node) {
+	trace_node = node;
+	CyclesInit();
+}
+
+static const TraceEntry *entry(unsigned int i) {
+	return &trace_ring[(trace_head - trace_used + i) & TRACE_MASK];
+}
+
+static void put_hex(void (*put)(unsigned char c), unsigned long value, unsigned int digits) {
+	while (digits--) put("0123456789abcdef"[(value >> (4*digits)) & 0xF]);
+}
+
+static void put_line(void (*put)(unsigned char c), const char *s) {
+	while (*s) put(*s++);
+}
+
+void TraceDump(void (*put)(unsigned char c)) {
+	const TraceEntry *e;
+	unsigned int i;
+
+	trace_frozen = 1;
+	put_line(put, "\r\n@TRACE ");
+	put_hex(put, trace_node, 2);
+	put(' ');
+	put_hex(put, trace_used, 4);
+	put_line(put, "\r\n");
+	for (i = 0; i < trace_used; i++) {
+		e = entry(i);
+		put_hex(put, e->time, 8);
+		put(' ');
+		put_hex(put, e->event, 2);
+		put(' ');
+		put_hex(put, e->arg, 4);
+		put_line(put, "\r\n");
+	}
+	put_line(put, "@END\r\n");
+	trace_frozen = 0;
+}
+
+void TraceDumpCan() {
+	trace_frozen = 1;
+	dump_next = 0;
+	dump_count = trace_used;
+}
+
+unsigned char TraceDumpCanNext() {
+	const TraceEntry *e;
+
+	if (!trace_frozen) return 0;
+	while (dump_next < dump_count && CANTxDepth() < CAN_TX_QUEUE/2) {
+		e = entry(dump_next++);
+		PROTO_SEND(TRACE_DUMP, e->time & 0xFFFF, e->time >> 16,
+				   PROTO_PAIR(e->event, trace_node), e->arg);
+	}
+	if (dump_next < dump_count) return 1;
+	trace_frozen = 0;
+	return 0;
+}
+#endif
@@ -0,0 +1,84 @@
+/* trace.h - Registro de eventos en RAM con marca de tiempo, volcado por la UART o el CAN. */
+#ifndef TRACE_H
+#define TRACE_H
+#include "irq.h"
+#include "cycles.h"
+
+// Events: X(identifier, name shown by the decoder, meaning of the argument)
+#define TRACE_EVENTS(X) \
+	X(TR_ISR_C1,		"isr C1",		"C1INTF") \
+	X(TR_ISR_U1RX,		"isr U1RX",		"byte") \
+	X(TR_ISR_ADC,		"isr ADC",		"sum") \
+	X(TR_TICK,			"tick",			"ticks") \
+	X(TR_CAN_RX,		"can rx",		"id") \
+	X(TR_CAN_TX,		"can tx",		"id") \
+	X(TR_EVENT,			"event",		"type, arg") \
+	X(TR_FRAME,			"frame",		"changes") \
+	X(TR_FRAME_END,		"frame end",	"bytes") \
+	X(TR_FRAME_DROP,	"frame drop",	"uart depth") \
+	X(TR_MARK,			"mark",			"")
+
+#define TRACE_ID(id, name, arg)		id,
+enum { TRACE_EVENTS(TRACE_ID) TRACE_COUNT };
+
+// Events kept in the ring (power of 2), the oldest are overwritten
+#ifndef TRACE_SIZE
+#define TRACE_SIZE	32
+#endif
+#define TRACE_MASK	(TRACE_SIZE - 1)
+
+typedef struct {
+	unsigned long time;			// CyclesRead()
+	unsigned char event;
+	unsigned int arg;
+} TraceEntry;
+
+#ifdef TRACE
+extern TraceEntry trace_ring[TRACE_SIZE];
+extern unsigned int trace_head, trace_used;
+extern volatile unsigned char trace_frozen;
+
+// Start the clock of the stamps (cycles.h), node goes in the dumps
+void TraceInit(unsigned char node);
+
+// Log an event, from the interrupts or the main loop. Dropped while a dump
+// reads the ring.
+static inline void TraceLog(unsigned char event, unsigned int arg) {
+	unsigned int ipl;
+	TraceEntry *e;
+
+	IRQ_DISABLE(ipl);
+	if (!trace_frozen) {
+		e = &trace_ring[trace_head];
+		trace_head = (trace_head + 1) & TRACE_MASK;
+		if (trace_used < TRACE_SIZE) trace_used++;
+		e->time = CyclesRead();
+		e->event = event;
+		e->arg = arg;
+	}
+	IRQ_RESTORE(ipl);
+}
+
+// Write the ring, oldest first, as text lines through put: "@TRACE node count",
+// then "time event arg" in hex, then "@END". From the main loop.
+void TraceDump(void (*put)(unsigned char c));
+
+// Send the ring as TRACE_DUMP frames, oldest first. TraceDumpCan starts the
+// dump and TraceDumpCanNext, from the main loop, queues the frames that fit in
+// half the CAN tx queue. It returns 1 while there are frames left to send.
+void TraceDumpCan(void);
+unsigned char TraceDumpCanNext(void);
+
+#define TRACE_INIT(node)		TraceInit(node)
+#define TRACE_LOG(event, arg)	TraceLog(event, arg)
+#define TRACE_DUMP_CAN()		TraceDumpCan()
+#define TRACE_DUMP_CAN_NEXT()	TraceDumpCanNext()
+#else
+// Compiled out: no code and no RAM
+#define TRACE_INIT(node)
+#define TRACE_LOG(event, arg)
+#define TRACE_DUMP_CAN()
+#define TRACE_DUMP_CAN_NEXT()
+#endif
+
+#endif
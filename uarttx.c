@@ -0,0 +1,59 @@
+/* uarttx.c - Implementación de las funciones de uarttx.h. */
+#include "uarttx.h"
+#include "irq.h"
+
+#define TX_MASK		(UART_TX_QUEUE - 1)
+
+// Bytes waiting for the UART. Single producer (main loop) and single consumer
+// (_U1TXInterrupt): each side only writes its own index.
+static volatile unsigned char tx_queue[UART_TX_QUEUE];
+static volatile unsigned char tx_head, tx_tail;
+// Statistics
+static unsigned int tx_high_water, tx_stalls;
+
+/* Moves queued bytes into the 4-deep hardware buffer.
+ * Must run with the U1TX interrupt masked or from _U1TXInterrupt.
+ */
+static void tx_feed() {
+	while (tx_tail != tx_head && !U1STAbits.UTXBF) {
+		U1TXREG = tx_queue[tx_tail];
+		tx_tail = (tx_tail + 1) & TX_MASK;
+	}
+	// Nothing left: no interrupt until the next byte is queued
+	IEC0bits.U1TXIE = (tx_tail != tx_head);
+}
+
+void UartTxPut(unsigned char c) {
+	unsigned int ipl, depth;
+	unsigned char next = (tx_head + 1) & TX_MASK;
+
+	if (next == tx_tail) {
+		tx_stalls++;
+		while (next == tx_tail);	// Full, wait for _U1TXInterrupt
+	}
+	tx_queue[tx_head] = c;
+	tx_head = next;
+	depth = (tx_head - tx_tail) & TX_MASK;
+	if (depth > tx_high_water) tx_high_water = depth;
+
+	// Start the transmission if the UART was idle
+	IRQ_DISABLE(ipl);
+	tx_feed();
+	IRQ_RESTORE(ipl);
+}
+
+void UartTxInterrupt() {
+	tx_feed();
+}
+
+unsigned int UartTxDepth() {
+	return (tx_head - tx_tail) & TX_MASK;
+}
+
+unsigned int UartTxHighWater() {
+	return tx_high_water;
+}
+
+unsigned int UartTxStalls() {
+	return tx_stalls;
+}
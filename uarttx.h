@@ -0,0 +1,24 @@
+/* uarttx.h - Transmisión por la UART1 con cola y por interrupción. */
+#ifndef UARTTX_H
+#define UARTTX_H
+#include <p30f4011.h>
+
+// Transmission queue length in bytes (power of 2, one slot is kept free)
+#ifndef UART_TX_QUEUE
+#define UART_TX_QUEUE	128
+#endif
+
+// Queue a byte for transmission. Only waits for the queue to drain if it is
+// full, so it must not be called with the CPU priority above the U1TX one.
+void UartTxPut(unsigned char c);
+
+// Transmission handler, must be called from _U1TXInterrupt
+// (requires UTXISEL = 1: interrupt when the transmit buffer is empty)
+void UartTxInterrupt(void);
+
+// Transmission queue statistics
+unsigned int UartTxDepth(void);		// Bytes waiting for the UART
+unsigned int UartTxHighWater(void);	// Maximum depth reached
+unsigned int UartTxStalls(void);	// Times UartTxPut waited for a free slot
+
+#endif